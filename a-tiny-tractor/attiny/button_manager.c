@@ -1,93 +1,83 @@
-/**
- *  @file button_manager.c
- *  @author William Spinelli <william.spinelli(on)gmail>
- *  @brief Implementation for the functions defined in button_manager.h.
- *  @warning Members listed here are intended for internal use only and should
- *  not be used directly!
- */
-
-#include "button_manager.h"
-
-/**
- *  @def BM(button)
- *  @brief Macro that returns the bitmask for the button with index \a button.
- */
-#define BM(button) (1 << (button))
-
-/**
- *  @brief Variable holding the button level.
- *
- *  This variable holds the level of the buttons packed in a single uint8_t.
- *  In order to extract the proper value, the variable should be masked using
- *  the macro BM.
- */
-static uint8_t button_level = 0x00;
-
-/**
- *  @brief Variable holding whether the button was clicked.
- *
- *  This variable holds the click status of the buttons packed in a single
- *  uint8_t.  In order to extract the proper value, the variable should be
- *  masked using the macro BM.
- */
-static uint8_t button_clicked = 0x00;
-
-/**
- *  @def ADC_THRESHOLD_OFF
- *  @brief Threshold below which no button is pressed.
- */
-#define ADC_THRESHOLD_OFF       23
-
-/**
- *  @def ADC_THRESHOLD_ON
- *  @brief Threshold below which ON button is pressed.
- */
-#define ADC_THRESHOLD_ON        63
-
-/**
- *  @def ADC_THRESHOLD_ON_HORN
- *  @brief Threshold below which ON and HORN buttons are pressed.
- */
-#define ADC_THRESHOLD_ON_HORN   99
-
-/**
- *  @def ADC_THRESHOLD_ON_START
- *  @brief Threshold below which ON and START buttons are pressed.
- */
-#define ADC_THRESHOLD_ON_START  186
-
-void button_set_adc_value(uint8_t adc_value)
-{
-    uint8_t button_new_level;
-
-    // find the new button level based on the ADC value
-    if (adc_value <= ADC_THRESHOLD_OFF)
-        button_new_level = 0x00;
-    else if (adc_value <= ADC_THRESHOLD_ON)
-        button_new_level = BM(BUTTON_ON);
-    else if (adc_value <= ADC_THRESHOLD_ON_HORN)
-        button_new_level = BM(BUTTON_ON) | BM(BUTTON_HORN);
-    else if (adc_value <= ADC_THRESHOLD_ON_START)
-        button_new_level = BM(BUTTON_ON) | BM(BUTTON_START);
-    else
-        button_new_level = BM(BUTTON_ON) | BM(BUTTON_START) | BM(BUTTON_HORN);
-
-    // check if there is a rising edge in the button level
-    button_clicked |= (~button_level & button_new_level) &
-            ((1 << BUTTON_COUNT) - 1);
-
-    button_level = button_new_level;
-}
-
-bool button_is_pressed(uint8_t button)
-{
-    return (button_level & BM(button)) != 0;
-}
-
-bool button_is_clicked(uint8_t button)
-{
-    uint8_t mask = (uint8_t)BM(button);
-    bool clicked = (button_clicked & mask) != 0;
-    button_clicked &= ~mask;        // reset the click flag!
-    return clicked;
-}
+/**
+ *  @file button_manager.c
+ *  @author William Spinelli <william.spinelli(on)gmail>
+ *  @brief Implementation for the functions defined in button_manager.h.
+ *  @warning Members listed here are intended for internal use only and should
+ *  not be used directly!
+ */
+
+#include "button_manager.h"
+
+#include "platform.h"
+#include "trace.h"
+
+#include <tiny_input.h>
+
+/**
+ *  @def BM(button)
+ *  @brief Macro that returns the bitmask for the button with index \a button.
+ */
+#define BM(button) (1 << (button))
+
+/**
+ *  @brief Variable holding the button level and the pending clicks.
+ *
+ *  This variable holds the level of the buttons and their rising edges not
+ *  yet consumed, each packed in a single uint8_t.  In order to extract the
+ *  proper value, the fields should be masked using the macro BM.
+ */
+MODULE_STATE TinyEvents button_events = {0x00, 0x00};
+
+/**
+ *  @def BUTTON_LADDER_STEPS
+ *  @brief The number of steps of the resistive network below the top one.
+ */
+#define BUTTON_LADDER_STEPS     4
+
+/**
+ *  @brief The steps of the resistive network.
+ *
+ *  Each step holds the highest ADC value (only the 8 most significant bits)
+ *  of a combination of buttons.  Above the last threshold all the buttons are
+ *  pressed.
+ */
+static const TinyLadderStep BUTTON_LADDER[BUTTON_LADDER_STEPS]
+        TINY_INPUT_PROGMEM = {
+    {23,    0x00},                                          // no button
+    {63,    BM(BUTTON_ON)},                                 // ON
+    {99,    BM(BUTTON_ON) | BM(BUTTON_HORN)},               // ON + HORN
+    {186,   BM(BUTTON_ON) | BM(BUTTON_START)},              // ON + START
+};
+
+void button_set_adc_value(uint8_t adc_value)
+{
+    TRACE_BEGIN("button_set_adc_value");
+
+    // find the new button level based on the ADC value
+    uint8_t button_new_level = tiny_ladder_decode(BUTTON_LADDER,
+            BUTTON_LADDER_STEPS,
+            BM(BUTTON_ON) | BM(BUTTON_START) | BM(BUTTON_HORN), adc_value);
+
+    // check if there is a rising edge in the button level
+    tiny_events_update(&button_events, button_new_level);
+
+    TRACE_COUNTER("adc_buttons", adc_value);
+    TRACE_END("button_set_adc_value");
+}
+
+bool button_is_pressed(uint8_t button)
+{
+    return (button_events.level & BM(button)) != 0;
+}
+
+bool button_is_clicked(uint8_t button)
+{
+    // reset the click flag!
+    return tiny_events_take(&button_events, (uint8_t)BM(button)) != 0;
+}
+
+void button_reset(void)
+{
+    button_events.level = 0x00;
+    button_events.pressed = 0x00;
+}
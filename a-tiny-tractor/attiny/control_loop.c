@@ -0,0 +1,89 @@
+/**
+ *  @file control_loop.c
+ *  @author William Spinelli <william.spinelli(on)gmail>
+ *  @brief Implementation for the functions defined in control_loop.h.
+ *  @warning Members listed here are intended for internal use only and should
+ *  not be used directly!
+ */
+
+#include "control_loop.h"
+
+#include "platform.h"
+#include "button_manager.h"
+#include "ecu_bus.h"
+#include "ram_monitor.h"
+#include "sound_manager.h"
+#include "tractor_model.h"
+
+/**
+ *  @brief Structure holding the counters of the main loop.
+ */
+typedef struct {
+    uint16_t    model_timer;        /**< Samples since the last model update. */
+    uint8_t     diagnostic_timer;   /**< Model updates since the last diagnostic. */
+} ControlTimers;
+
+/**
+ *  @def CONTROL_TIMERS_INITIAL_STATE
+ *  @brief Initializer for the counters of the main loop.
+ */
+#define CONTROL_TIMERS_INITIAL_STATE {  \
+    .model_timer        = 0,            \
+    .diagnostic_timer   = 0,            \
+}
+
+/**
+ *  @brief Counters of the main loop.
+ */
+MODULE_STATE ControlTimers control_timers = CONTROL_TIMERS_INITIAL_STATE;
+
+uint8_t control_get_next_sample(void)
+{
+    ++control_timers.model_timer;
+    return audio_get_next_sample(tractor_get_engine_speed());
+}
+
+bool control_is_model_update_due(void)
+{
+    return control_timers.model_timer >= CONTROL_MODEL_CYCLE;
+}
+
+void control_update_model(uint8_t adc_throttle, uint8_t adc_buttons)
+{
+    control_timers.model_timer = 0;
+
+    // Manage button status
+    button_set_adc_value(adc_buttons);
+    if (button_is_clicked(BUTTON_HORN))
+        tractor_play_dixie_song();
+
+    if (button_is_pressed(BUTTON_START))
+        tractor_set_ignition_position(IGNITION_START);
+    else if (button_is_pressed(BUTTON_ON))
+        tractor_set_ignition_position(IGNITION_ON);
+    else
+        tractor_set_ignition_position(IGNITION_OFF);
+
+    // Update tractor model
+    bool led_status;
+    tractor_set_engine_speed_setpoint(ENGINE_SPEED_IDLE +
+            ((adc_throttle - ADC_THROTTLE_IDLE) >> 1));
+    led_status = tractor_update_model();
+
+    // Update outputs to slave ECU
+    ecu_bus_send_status(tractor_get_engine_status(),
+            tractor_get_engine_speed(),
+            led_status ? ECU_LIGHT_BEACON : 0);
+
+    // Update diagnostics @ 1 Hz
+    if (++control_timers.diagnostic_timer >= CONTROL_DIAGNOSTIC_CYCLE) {
+        control_timers.diagnostic_timer = 0;
+        ram_monitor_update();
+        ecu_bus_send_diagnostic(ram_monitor_get_free());
+    }
+}
+
+void control_reset(void)
+{
+    control_timers = (ControlTimers)CONTROL_TIMERS_INITIAL_STATE;
+}
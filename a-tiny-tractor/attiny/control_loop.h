@@ -0,0 +1,101 @@
+/**
+ *  @file control_loop.h
+ *  @author William Spinelli <william.spinelli(on)gmail>
+ *
+ *  @brief The body of the main loop, shared by the firmware and the native
+ *  builds.
+ *
+ *  This module holds the logic run by main.c for every audio sample (8 kHz)
+ *  and for every update of the tractor model (25 Hz): it reads the buttons
+ *  and the throttle, updates the tractor model, and sends the status (and
+ *  once per second the diagnostic) to the slave ECU.  main.c only adds the
+ *  hardware around it: the sample trigger, OCR1B and the ADC scan.
+ *
+ *  The lockstep runner (see the lockstep directory) calls the same functions
+ *  natively, so that the emulated firmware is compared with the code it
+ *  actually runs.  For every audio sample:
+ *
+ *  @code
+ *  sample = control_get_next_sample();
+ *  if (control_is_model_update_due())
+ *      control_update_model(adc_throttle, adc_buttons);
+ *  @endcode
+ */
+
+#ifndef CONTROL_LOOP_H
+#define CONTROL_LOOP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ *  @def CONTROL_MODEL_CYCLE
+ *  @brief Period of the tractor model update.
+ *
+ *  This constant represents the cycle time used to downsample the audio
+ *  sample update cycle (8 kHz) to the model update rate (25 Hz = 40 ms).
+ */
+#define CONTROL_MODEL_CYCLE     (8000 / 25)
+
+/**
+ *  @def CONTROL_DIAGNOSTIC_CYCLE
+ *  @brief Period of the diagnostic update.
+ *
+ *  This constant represents the cycle time used to downsample the tractor
+ *  model update rate (25 Hz) to the diagnostic update rate (1 Hz).
+ */
+#define CONTROL_DIAGNOSTIC_CYCLE    25
+
+/**
+ *  @def ADC_THROTTLE_IDLE
+ *  @brief The throttle ADC value associated to the idle engine speed.
+ */
+#define ADC_THROTTLE_IDLE       38
+
+/**
+ *  @brief Generate the next audio sample.
+ *
+ *  This function generates the audio sample for the current engine speed and
+ *  counts the samples up to the next model update.
+ *  @return The audio sample (PWM duty cycle).
+ *  @note This function should be called every 125 us (8 kHz).
+ */
+uint8_t control_get_next_sample(void);
+
+/**
+ *  @brief Check if the tractor model has to be updated.
+ *  @return true once @a CONTROL_MODEL_CYCLE samples have been generated
+ *  since the last model update.
+ */
+bool control_is_model_update_due(void);
+
+/**
+ *  @brief Update the tractor model from the ADC values.
+ *
+ *  This function updates the buttons and the ignition position, converts the
+ *  throttle ADC value to an engine speed setpoint, updates the tractor model
+ *  and sends its status to the slave ECU.  The ADC values are the 8 most
+ *  significant bits of the readings; the throttle is converted using the
+ *  following relation:
+ *  Voltage: 0.15 Vcc -> ADC: 38 -> setpoint: 64 (800 rpm)
+ *  Voltage: 0.90 Vcc -> ADC: 230 -> setpoint: 168 (2100 rpm)
+ *  Relation: setpoint = 64 + (ADC - 38) * 104 / 192 ~> 64 + (ADC - 38) >> 1
+ *  There is no need to saturate low setpoint value, since this is
+ *  already done insider the function tractor_set_engine_speed_setpoint.
+ *  Every @a CONTROL_DIAGNOSTIC_CYCLE updates the free RAM is measured and
+ *  sent to the slave ECU as well.
+ *  @param adc_throttle The ADC value read on the throttle.
+ *  @param adc_buttons The ADC value read on the resistive network of the
+ *  buttons.
+ *  @note This function should be called when control_is_model_update_due
+ *  returns true.
+ */
+void control_update_model(uint8_t adc_throttle, uint8_t adc_buttons);
+
+/**
+ *  @brief Bring the loop counters back to their initial state.
+ *  @note The other modules are not reset.
+ */
+void control_reset(void);
+
+#endif
@@ -0,0 +1,276 @@
+/**
+ *  @file ecu_bus.c
+ *  @author William Spinelli <william.spinelli(on)gmail>
+ *  @brief Implementation for the functions defined in ecu_bus.h.
+ *  @warning Members listed here are intended for internal use only and should
+ *  not be used directly!
+ */
+
+#include "ecu_bus.h"
+
+#include "platform.h"
+
+#ifdef __AVR__
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#endif
+
+/**
+ *  @def ECU_BUS_QUEUE_SIZE
+ *  @brief The size of the transmission queue (a status and a diagnostic frame).
+ */
+#define ECU_BUS_QUEUE_SIZE      (2 * ECU_FRAME_SIZE)
+
+/**
+ *  @brief Compute the checksum byte of a frame.
+ *  @param byte0 The first byte of the frame.
+ *  @param byte1 The second byte of the frame.
+ *  @return The checksum byte.
+ */
+static inline uint8_t ecu_bus_checksum(uint8_t byte0, uint8_t byte1)
+{
+    return (uint8_t)(byte0 + byte1) & 0x7F;
+}
+
+#ifdef __AVR__
+
+/**
+ *  @brief Structure holding the transmission queue.
+ *
+ *  The bytes are stored bit-reversed, ready to be shifted out MSB first by
+ *  the USI.  The queue is emptied by the USI overflow interrupt and is reset
+ *  when the transmission is complete.
+ */
+typedef struct {
+    uint8_t byte[ECU_BUS_QUEUE_SIZE];   /**< The queued bytes (bit-reversed). */
+    uint8_t size;                       /**< The number of queued bytes. */
+    uint8_t index;                      /**< The index of the byte being sent. */
+    bool    second_half;                /**< Whether the second half is next. */
+} EcuQueue;
+
+/**
+ *  @brief The transmission queue, shared with the USI overflow interrupt.
+ */
+static volatile EcuQueue queue = {{0}, 0, 0, false};
+
+/**
+ *  @brief Reverse the bit order of a byte.
+ *  @param byte The byte to reverse.
+ *  @return The reversed byte.
+ */
+static uint8_t reverse_bits(uint8_t byte)
+{
+    uint8_t reversed = 0;
+    for (uint8_t i = 0; i < 8; ++i) {
+        reversed = (reversed << 1) | (byte & 0x01);
+        byte >>= 1;
+    }
+    return reversed;
+}
+
+/**
+ *  @brief Queue a frame and start the transmission if the line is idle.
+ *  @param byte0 The first byte of the frame.
+ *  @param byte1 The second byte of the frame.
+ *  @return false if the queue is full.
+ */
+static bool ecu_bus_send_frame(uint8_t byte0, uint8_t byte1)
+{
+    uint8_t frame[ECU_FRAME_SIZE] = {
+        reverse_bits(byte0),
+        reverse_bits(byte1),
+        reverse_bits(ecu_bus_checksum(byte0, byte1)),
+    };
+
+    bool queued = false;
+    uint8_t sreg = SREG;
+    cli();
+    if (queue.size + ECU_FRAME_SIZE <= ECU_BUS_QUEUE_SIZE) {
+        for (uint8_t i = 0; i < ECU_FRAME_SIZE; ++i)
+            queue.byte[queue.size + i] = frame[i];
+        queue.size += ECU_FRAME_SIZE;
+        queued = true;
+
+        if (!(USICR & _BV(USIOIE))) {
+            /*
+             * Keep the line idle for one more bit, so that the first start
+             * bit is loaded by the interrupt right on a TIMER0 compare match.
+             */
+            USIDR = 0xFF;
+            USISR = _BV(USIOIF) | (16 - 1);
+            USICR |= _BV(USIOIE);
+        }
+    }
+    SREG = sreg;
+    return queued;
+}
+
+/**
+ *  @brief ISR associated to USI counter overflow.
+ *
+ *  This function loads the next half byte in the USI data register:
+ *  - first half: start bit (0) and data bits 0 to 6, sent in 8 bits.
+ *  - second half: data bit 7 and stop bit (1), sent in 2 bits.
+ *  The bits after the stop bit are all 1 (the data register is filled with
+ *  1 and DI is held high), so the line stays idle when the queue is empty.
+ */
+ISR (USI_OVF_vect)
+{
+    if (queue.second_half) {
+        USIDR = (uint8_t)(queue.byte[queue.index] << 7) | 0x7F;
+        USISR = _BV(USIOIF) | (16 - 2);
+        queue.second_half = false;
+        ++queue.index;
+    } else if (queue.index < queue.size) {
+        USIDR = queue.byte[queue.index] >> 1;
+        USISR = _BV(USIOIF) | (16 - 8);
+        queue.second_half = true;
+    } else {
+        USICR &= ~_BV(USIOIE);
+        USISR = _BV(USIOIF);
+        queue.size = 0;
+        queue.index = 0;
+    }
+}
+
+void ecu_bus_init(void)
+{
+    DDRB |= _BV(DDB1) |             // set DO (pin 6) as output
+            _BV(DDB0);              // set DI (pin 5) as output...
+    PORTB |= _BV(PB1) |             // ...held high, it is shifted in the USI
+            _BV(PB0);
+
+    USIDR = 0xFF;                   // idle line
+    USICR = _BV(USIWM0) |           // three-wire mode
+            _BV(USICS0);            // clocked by TIMER0 compare match
+}
+
+void ecu_bus_reset(void)
+{
+    uint8_t sreg = SREG;
+    cli();
+    USICR &= ~_BV(USIOIE);
+    queue.size = 0;
+    queue.index = 0;
+    queue.second_half = false;
+    USIDR = 0xFF;
+    SREG = sreg;
+}
+
+#else
+
+/**
+ *  @def ECU_BUS_LOOPBACK_SIZE
+ *  @brief The size of the native loopback buffer (power of 2).
+ */
+#define ECU_BUS_LOOPBACK_SIZE   64
+
+/**
+ *  @brief Structure holding the native loopback buffer.
+ */
+typedef struct {
+    uint8_t byte[ECU_BUS_LOOPBACK_SIZE];    /**< The bytes sent. */
+    uint8_t head;                           /**< Index of the next byte to write. */
+    uint8_t tail;                           /**< Index of the next byte to read. */
+} EcuLoopback;
+
+/**
+ *  @def ECU_LOOPBACK_INITIAL_STATE
+ *  @brief Initializer for the native loopback buffer (empty).
+ */
+#define ECU_LOOPBACK_INITIAL_STATE {    \
+    .byte   = {0},                      \
+    .head   = 0,                        \
+    .tail   = 0,                        \
+}
+
+/**
+ *  @brief The native loopback buffer.
+ */
+MODULE_STATE EcuLoopback loopback = ECU_LOOPBACK_INITIAL_STATE;
+
+/**
+ *  @brief Queue a frame on the native loopback.
+ *  @param byte0 The first byte of the frame.
+ *  @param byte1 The second byte of the frame.
+ *  @return false if the loopback buffer is full.
+ */
+static bool ecu_bus_send_frame(uint8_t byte0, uint8_t byte1)
+{
+    uint8_t used = (uint8_t)(loopback.head - loopback.tail);
+    if (used + ECU_FRAME_SIZE > ECU_BUS_LOOPBACK_SIZE)
+        return false;
+
+    uint8_t frame[ECU_FRAME_SIZE] = {
+        byte0, byte1, ecu_bus_checksum(byte0, byte1),
+    };
+    for (uint8_t i = 0; i < ECU_FRAME_SIZE; ++i)
+        loopback.byte[loopback.head++ & (ECU_BUS_LOOPBACK_SIZE - 1)] = frame[i];
+    return true;
+}
+
+void ecu_bus_init(void)
+{
+}
+
+bool ecu_bus_loopback_read(uint8_t *byte)
+{
+    if (loopback.head == loopback.tail)
+        return false;
+    *byte = loopback.byte[loopback.tail++ & (ECU_BUS_LOOPBACK_SIZE - 1)];
+    return true;
+}
+
+void ecu_bus_reset(void)
+{
+    loopback = (EcuLoopback)ECU_LOOPBACK_INITIAL_STATE;
+}
+
+#endif
+
+bool ecu_bus_send_status(uint8_t engine_status, uint8_t engine_speed,
+        uint8_t lights)
+{
+    return ecu_bus_send_frame(0x80 | ((engine_status & 0x07) << 4) |
+            (lights & 0x0F), engine_speed >> 1);
+}
+
+bool ecu_bus_send_diagnostic(uint16_t free_ram)
+{
+    if (free_ram > 0x07FF)
+        free_ram = 0x07FF;
+    return ecu_bus_send_frame(0x80 | (ECU_FRAME_DIAGNOSTIC << 4) |
+            (uint8_t)(free_ram >> 7), (uint8_t)(free_ram & 0x7F));
+}
+
+bool ecu_bus_decode(EcuDecoder *decoder, uint8_t byte, EcuFrame *frame)
+{
+    // The first byte of a frame is the only one with the MSB set
+    if (byte & 0x80)
+        decoder->size = 0;
+    else if (decoder->size == 0)
+        return false;
+
+    decoder->byte[decoder->size++] = byte;
+    if (decoder->size < ECU_FRAME_SIZE)
+        return false;
+    decoder->size = 0;
+
+    if (ecu_bus_checksum(decoder->byte[0], decoder->byte[1]) != decoder->byte[2]) {
+        ++decoder->errors;
+        return false;
+    }
+
+    frame->kind = (decoder->byte[0] >> 4) & 0x07;
+    if (frame->kind == ECU_FRAME_DIAGNOSTIC) {
+        frame->lights       = 0;
+        frame->engine_speed = 0;
+        frame->free_ram     = ((uint16_t)(decoder->byte[0] & 0x0F) << 7) |
+                decoder->byte[1];
+    } else {
+        frame->lights       = decoder->byte[0] & 0x0F;
+        frame->engine_speed = decoder->byte[1] << 1;
+        frame->free_ram     = 0;
+    }
+    return true;
+}
@@ -0,0 +1,131 @@
+/**
+ *  @file ecu_bus.h
+ *  @author William Spinelli <william.spinelli(on)gmail>
+ *
+ *  @brief Stream the tractor status to a slave ECU over a serial line.
+ *
+ *  The LED and the DC motor are driven by a slave ECU (see the reference
+ *  implementation in the slave_ecu directory), so that the ATtiny85 only has
+ *  to generate the audio and run the tractor model.  Every model update
+ *  (40 ms) a status frame with the engine status, the engine speed and the
+ *  lights is sent, and once per second a diagnostic frame with the free RAM.
+ *
+ *  The line is a plain UART (8 data bits, no parity, 1 stop bit, LSB first)
+ *  at 8000 baud on pin 6 (PB1).  It is generated by the USI in three-wire
+ *  mode, clocked by the TIMER0 compare match that also triggers the audio
+ *  samples, so that every bit lasts exactly one audio sample period.  Each
+ *  byte is shifted out in two halves loaded by the USI overflow interrupt:
+ *  the start bit with the first 7 data bits, then the last data bit with the
+ *  stop bit.  The USI shifts MSB first, so the bytes are bit-reversed when
+ *  queued.
+ *
+ *  Each frame is made of three bytes, where only the first one has the most
+ *  significant bit set, so that the receiver can always synchronize:
+ *   - byte 0: 1 k k k d d d d (k: frame kind, d: 4 bits of data)
+ *   - byte 1: 0 v v v v v v v (v: 7 bits of value)
+ *   - byte 2: 0 c c c c c c c (c: (byte 0 + byte 1) & 0x7F)
+ *
+ *  For a status frame the kind is the engine status (ENGINE_STATUS_OFF and
+ *  following), the data are the lights (ECU_LIGHT_BEACON...) and the value is
+ *  the engine speed divided by 2.  For a diagnostic frame the kind is
+ *  ECU_FRAME_DIAGNOSTIC, and data and value are the 4 high bits and the 7 low
+ *  bits of the free RAM.
+ *
+ *  On the native builds the bytes are stored in a loopback buffer that can be
+ *  read back with ecu_bus_loopback_read, and decoded with ecu_bus_decode like
+ *  the slave ECU does.
+ */
+
+#ifndef ECU_BUS_H
+#define ECU_BUS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ *  @def ECU_FRAME_SIZE
+ *  @brief The size of a frame in bytes.
+ */
+#define ECU_FRAME_SIZE          3
+
+/**
+ *  @def ECU_FRAME_DIAGNOSTIC
+ *  @brief The frame kind used for diagnostic frames.
+ */
+#define ECU_FRAME_DIAGNOSTIC    7
+
+/**
+ *  @brief Enumeration of the lights managed by the slave ECU (bitmask).
+ */
+enum {
+    ECU_LIGHT_BEACON    = 0x01, /**< The blinking LED light. */
+};
+
+/**
+ *  @brief Structure holding a decoded frame.
+ */
+typedef struct {
+    uint8_t     kind;           /**< Engine status or ECU_FRAME_DIAGNOSTIC. */
+    uint8_t     lights;         /**< The lights (status frame). */
+    uint8_t     engine_speed;   /**< The engine speed, even values only (status frame). */
+    uint16_t    free_ram;       /**< The free RAM in bytes (diagnostic frame). */
+} EcuFrame;
+
+/**
+ *  @brief Structure holding the status of a frame decoder.
+ */
+typedef struct {
+    uint8_t     byte[ECU_FRAME_SIZE];   /**< The bytes received so far. */
+    uint8_t     size;                   /**< The number of bytes received. */
+    uint16_t    errors;                 /**< Frames dropped for a bad checksum. */
+} EcuDecoder;
+
+/**
+ *  @brief Initialize the USI transmitter.
+ *  @note TIMER0 must already be running in CTC mode at 8 kHz.
+ */
+void ecu_bus_init(void);
+
+/**
+ *  @brief Queue a status frame.
+ *  @param engine_status The engine status (ENGINE_STATUS_OFF and following).
+ *  @param engine_speed The engine speed.
+ *  @param lights The lights that are on (ECU_LIGHT_BEACON...).
+ *  @return false if the frame was dropped because the queue is full.
+ */
+bool ecu_bus_send_status(uint8_t engine_status, uint8_t engine_speed,
+        uint8_t lights);
+
+/**
+ *  @brief Queue a diagnostic frame.
+ *  @param free_ram The free RAM in bytes (saturated to 2047).
+ *  @return false if the frame was dropped because the queue is full.
+ */
+bool ecu_bus_send_diagnostic(uint16_t free_ram);
+
+/**
+ *  @brief Feed a received byte to a frame decoder.
+ *
+ *  The decoder has to be zero-initialized before the first byte.
+ *  @param decoder The decoder status.
+ *  @param byte The received byte.
+ *  @param frame The decoded frame, filled only when true is returned.
+ *  @return true if the byte completed a valid frame.
+ */
+bool ecu_bus_decode(EcuDecoder *decoder, uint8_t byte, EcuFrame *frame);
+
+#ifndef __AVR__
+/**
+ *  @brief Read the next byte sent on the native loopback.
+ *  @param byte The byte read.
+ *  @return false if there is no byte to read.
+ */
+bool ecu_bus_loopback_read(uint8_t *byte);
+#endif
+
+/**
+ *  @brief Discard the queued bytes and bring the module back to its initial state.
+ */
+void ecu_bus_reset(void);
+
+#endif
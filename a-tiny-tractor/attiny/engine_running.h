@@ -9,7 +9,10 @@
 #define PROGMEM
 #endif
 
+/* [0, LOOP_START) attack, [LOOP_START, LOOP_END) sustain loop, then release */
 #define ENGINE_RUNNING_SIZE 3696
+#define ENGINE_RUNNING_LOOP_START 0
+#define ENGINE_RUNNING_LOOP_END 3696
 static const uint8_t ENGINE_RUNNING[ENGINE_RUNNING_SIZE] PROGMEM = {
 129, 144, 136, 100, 87, 128, 156, 141, 131, 97, 127, 159, 115, 97, 85, 153, 
 143, 170, 178, 102, 94, 167, 255, 233, 83, 43, 140, 194, 90, 63, 190, 56, 
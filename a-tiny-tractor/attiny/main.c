@@ -14,6 +14,10 @@
  *   - a LED light, that blinks periodically
  *   - a DC motor, that turns at a speed proportional to the engine speed
  *
+ *  The LED and the DC motor are driven by a slave ECU, that receives the
+ *  engine status, the engine speed and the lights from the ATtiny85 over a
+ *  serial line (see ecu_bus.h and the slave_ecu directory).
+ *
  *  The core of the project is the sound generation.  It uses a quick and dirty
  *  looping technique to roughly generate engine sound effects with variable
  *  speed.  It also allow to play three different kind of horn songs (including
@@ -32,8 +36,8 @@
  *  - Pin 2: Throttle Input
  *  - Pin 3: Sound Output
  *  - Pin 4: GND
- *  - Pin 5: LED Output
- *  - Pin 6: DC MOTOR Output
+ *  - Pin 5: Not used (held high)
+ *  - Pin 6: Slave ECU serial Output (8000 baud)
  *  - Pin 7: Resistive network (Buttons ON, START, HORN)
  *  - Pin 8: Vcc
  *
@@ -57,41 +61,10 @@
 #include <avr/io.h>
 #include <avr/interrupt.h>
 
-#include "button_manager.h"
-#include "sound_manager.h"
-#include "tractor_model.h"
+#include "control_loop.h"
+#include "ecu_bus.h"
 
-/**
- *  @def LED_PIN
- *  @brief Define used to control level on pin connected to LED (pin 5).
- */
-#define LED_PIN                 PB0
-
-/**
- *  @def LED_OUT
- *  @brief Define used to set pin connected to LED (pin 5) as output.
- */
-#define LED_OUT                 DDB0
-
-/**
- *  @def DC_MOTOR_PIN
- *  @brief Define used to control level on pin connected to DC MOTOR (pin 6).
- */
-#define DC_MOTOR_PIN            PB1
-
-/**
- *  @def DC_MOTOR_OUT
- *  @brief Define used to set pin connected to DC MOTOR (pin 6) as output.
- */
-#define DC_MOTOR_OUT            DDB1
-
-/**
-  *  @brief Period of the tractor model update.
-  *
-  *  This constant represents the cycle time used to downsample the audio
-  *  sample update cycle (8 kHz) to the model update rate (25 Hz = 40 ms).
-  */
-static const uint16_t TRACTOR_MODEL_CYCLE = 8000 / 25;
+#include <tiny_input.h>
 
 /**
  *  @brief Flag used to trigger the generation of a new audio sample.
@@ -99,71 +72,38 @@ static const uint16_t TRACTOR_MODEL_CYCLE = 8000 / 25;
 static volatile bool update_audio_sample = false;
 
 /**
- *  @def PWM_DC_MOTOR_MIN
- *  @brief The minimum duty cycle on the DC MOTOR pin (10%).
- */
-#define PWM_DC_MOTOR_MIN        6
-
-/**
- *  @def PWM_DC_MOTOR_MAX
- *  @brief The maximum duty cycle on the DC MOTOR pin (90%).
- */
-#define PWM_DC_MOTOR_MAX        58
-
-/**
- *  @brief The value of the duty cycle for the PWM on the DC MOTOR pin.
- *
- *  This variable holds the value of the duty cycle for the soft PWM generated
- *  on the DC MOTOR output pin.  The PWM has a resolution of 6 bits, therefore
- *  63 means a duty cycle of 100%.  The soft PWM has a carrier frequency of
- *  125 Hz, and is generated inside the TIMER0 ISR.
- */
-static volatile uint8_t output_pwm_duty_cycle = 0;
-
-/**
- *  @brief The ADC value on the pin connected to throttle.
+ *  @brief Enumeration of the ADC channels managed by the software.
  *
- *  This variable holds the ADC value (only the 8 most significant bits) read
- *  on the pin connected to the throttle.  The throttle ADC value is converted
- *  to an engine speed setpoint using the following relation:
- *  Voltage: 0.15 Vcc -> ADC: 38 -> setpoint: 64 (800 rpm)
- *  Voltage: 0.90 Vcc -> ADC: 230 -> setpoint: 168 (2100 rpm)
- *  Relation: setpoint = 64 + (ADC - 38) * 104 / 192 ~> 64 + (ADC - 38) >> 1
- *  There is no need to saturate low setpoint value, since this is
- *  already done insider the function tractor_set_engine_speed_setpoint
+ *  The channels are converted in this order, one after the other, every time
+ *  a scan is started.
  */
-static volatile uint8_t adc_value_throttle = 0;
+enum {
+    ADC_READ_THROTTLE,  /**< The ADC channel connected to throttle. */
+    ADC_READ_BUTTONS,   /**< The ADC channel connected to buttons. */
+    ADC_READ_COUNT,     /**< Total ADC channels managed by the software. */
+};
 
 /**
- *  @def ADC_THROTTLE_IDLE
- *  @brief The throttle ADC value associated to the idle engine speed.
+ *  @brief The ADMUX channel selection of each ADC channel.
  */
-#define ADC_THROTTLE_IDLE       38
+static const uint8_t ADC_READ_MUX[ADC_READ_COUNT] = {
+    _BV(MUX1) | _BV(MUX0),          // ADC3 (pin 2)
+    _BV(MUX0),                      // ADC1 (pin 7)
+};
 
 /**
- *  @brief The ADC value on the pin connected to buttons.
+ *  @brief The ADC values of the channels.
  *
- *  This variable holds the ADC value (only the 8 most significant bits) read
- *  on the pin connected to the resistive network used to read the button
- *  status.
- */
-static volatile uint8_t adc_value_buttons = 0;
-
-/**
- *  @brief Enumeration of the ADC channels managed by the software.
+ *  This array holds the ADC values (only the 8 most significant bits) read
+ *  on the pins connected to the throttle and to the resistive network used to
+ *  read the button status.  They are converted by control_update_model.
  */
-enum {
-    ADC_READ_THROTTLE,  /**< The ADC channel connected to throttle. */
-    ADC_READ_BUTTONS,   /**< The ADC channel connected to buttons. */
-};
+static volatile uint8_t adc_value[ADC_READ_COUNT] = {0};
 
 /**
- *  @brief Select between the two ADC channels.
- *
- *  This variable is used to toggle between the two ADC channels managed in the
- *  software.
+ *  @brief The status of the ADC scan, only used by the @a ADC_vect ISR.
  */
-static volatile uint8_t adc_mux_selection = ADC_READ_THROTTLE;
+static TinyAdcScan adc_scan = {0, ADC_READ_COUNT};
 
 /**
  *  @brief Initialize the ATtiny85 peripherals
@@ -176,21 +116,21 @@ static inline void setup(void)
      * Init IO peripherals
      */
     MCUCR |= _BV(PUD);              // disable pull-ups globally
-    DDRB = _BV(LED_OUT) |           // set LED pin as output
-            _BV(DDB4) |             // set pin 2 as output (speaker)
-            _BV(DC_MOTOR_OUT);      // set DC MOTOR pin as output
+    DDRB = _BV(DDB4);               // set pin 3 as output (speaker)
 
     /*
-     * Init timer to manage audio samples and soft PWM
+     * Init timer to manage audio samples and the slave ECU serial line
      * Setup timer T0: interrupt @ 8.0kHz
      * T0 => F_CPU / prescaler / (OCR0A + 1) = 8000000 / 8 / 125 = 8 kHz
-     * Motor PWM => Soft PWM @ 125 Hz => 6 bit resolution
+     * ECU bus => USI clocked by T0 compare match => 8000 baud
      */
     TCCR0A = _BV(WGM01);            // Clear Timer on Compare mode
     TCCR0B = _BV(CS01);             // set Clock Prescaler to 8
     OCR0A = 124;                    // set Output Compare Register
     TIMSK = _BV(OCIE0A);            // enable Compare Match interrupt
 
+    ecu_bus_init();                 // USI transmitter to the slave ECU
+
     /*
      * Init timer for audio output in fast PWM mode @ 250 kHz
      * PWM  => F_CPU * PLL_8 / (OCR0C + 1) = 8000000 * 8 / 256 = 250 kHz
@@ -215,44 +155,6 @@ static inline void setup(void)
     sei();                          // enable interrupts
 }
 
-/**
- *  @brief Update the LED output pin.
- *  @param led_status Whether the led is ON or OFF.
- */
-static void output_set_led(bool led_status)
-{
-    if (led_status)
-        PORTB |= _BV(LED_PIN);
-    else
-        PORTB &= ~_BV(LED_PIN);
-}
-
-/**
- *  @brief Set the duty cycle on the DC MOTOR pin.
- *
- *  This function computes the value of the duty cycle for the soft PWM.  The
- *  duty cycle is kept to 0, while the engine speed is below the minimum speed
- *  @a ENGINE_SPEED_MIN.  Otherwise the duty cycle is computed according to the
- *  following relation:
- *  Speed: 68 (850 rpm) -> PWM: 6 (10%)
- *  Speed: 168 (2100 rpm) -> PWM: 56 (90%)
- *  Relation: PWM = 6 + (speed - 68) * 50 / 100 ~> 6 + (speed - 68) >> 1
- *  @param engine_speed The current engine speed.
- */
-static inline void output_set_dc_motor_pwm(uint8_t engine_speed)
-{
-    if (engine_speed < ENGINE_SPEED_MIN) {
-        output_pwm_duty_cycle = 0;
-    } else {
-        uint8_t duty_cycle = PWM_DC_MOTOR_MIN +
-                ((engine_speed - ENGINE_SPEED_IDLE) >> 1);
-        if (duty_cycle > (PWM_DC_MOTOR_MAX))
-            duty_cycle = PWM_DC_MOTOR_MAX;
-        output_pwm_duty_cycle = duty_cycle;
-    }
-}
-
-
 /**
  *  @brief Start the ADC conversion for the given input.
  *
@@ -263,51 +165,23 @@ static inline void output_set_dc_motor_pwm(uint8_t engine_speed)
  */
 static inline void adc_start_conversion(uint8_t mux)
 {
-    adc_mux_selection = mux;
-
-    switch (adc_mux_selection) {
-        default:
-            ADMUX |= _BV(MUX0) |    // select ADC3
-                    _BV(MUX1);
-            break;
-
-        case ADC_READ_BUTTONS:
-            ADMUX &= ~_BV(MUX1);    // clear selection
-            ADMUX |= _BV(MUX0);     // select ADC1
-            break;
-    }
-
+    ADMUX = _BV(ADLAR) |            // left adjust ADC read
+            ADC_READ_MUX[mux];      // select the channel
     ADCSRA |= _BV(ADSC);            // start the ADC conversion
 }
 
 /**
  *  @brief ISR associated to TIMER0 overflow.
  *
- *  This function is run with a rate of 8 kHz.  It basically does two things:
- *  - triggers the generation of a new audio sample.
- *  - generate a soft PWM with a carrier frequency of 125 Hz and a resolution
- *    of 6 bits.  Output is set at the beginning of the cycle and is reset
- *    when the counter is higher than the requested PWM duty cycle.
- *    If duty cycle is 0, then the output is not set to avoid a possible spike
- *    on the output.
+ *  This function is run with a rate of 8 kHz and triggers the generation of a
+ *  new audio sample.
  *  @note The audio sample update and all the main logic is performed outside
- *  the interrupt, to keep the soft PWM generation nice and smooth.
+ *  the interrupt.  The same compare match also clocks the USI transmitter of
+ *  the slave ECU serial line.
  */
 ISR (TIMER0_COMPA_vect)
 {
     update_audio_sample = true;
-
-    static uint8_t pwm_timer = 0;
-
-    if (++pwm_timer >= 64) {
-        pwm_timer = 0;
-
-        if (output_pwm_duty_cycle > 0)
-            PORTB |= _BV(DC_MOTOR_PIN);
-    }
-
-    if (pwm_timer >= output_pwm_duty_cycle)
-        PORTB &= ~_BV(DC_MOTOR_PIN);
 }
 
 
@@ -315,17 +189,15 @@ ISR (TIMER0_COMPA_vect)
  *  @brief ISR associated to ADC conversion.
  *
  *  This function simply stores the ADC value in some temporary variable when
- *  the conversion is complete.  Since two ADC have to be read, the second
- *  conversion is started in here when the first conversion is complete.
+ *  the conversion is complete.  Since more channels have to be read, the
+ *  conversion of the next channel of the scan is started in here, until the
+ *  scan is complete.
  */
 ISR (ADC_vect)
 {
-    if (adc_mux_selection == ADC_READ_THROTTLE) {
-        adc_value_throttle = ADCH;
-        adc_start_conversion(ADC_READ_BUTTONS);
-    } else {
-        adc_value_buttons = ADCH;
-    }
+    adc_value[adc_scan.slot] = ADCH;
+    if (!tiny_adc_scan_advance(&adc_scan))
+        adc_start_conversion(adc_scan.slot);
 }
 
 /**
@@ -334,8 +206,6 @@ ISR (ADC_vect)
  */
 int main(void)
 {
-    static uint16_t update_status_timer = 0;
-
     // Initialize hardware
     setup();
 
@@ -344,36 +214,14 @@ int main(void)
         while (!update_audio_sample);
 
         // Update audio samples @ 8 kHz.
-        uint8_t engine_speed = tractor_get_engine_speed();
-        OCR1B = audio_get_next_sample(engine_speed);
+        OCR1B = control_get_next_sample();
 
         // Update tractor model @ 25 Hz
-        if (++update_status_timer >= TRACTOR_MODEL_CYCLE) {
-            update_status_timer = 0;
-
-            // Manage button status
-            button_set_adc_value(adc_value_buttons);
-            if (button_is_clicked(BUTTON_HORN))
-                tractor_play_dixie_song();
-
-            if (button_is_pressed(BUTTON_START))
-                tractor_set_ignition_position(IGNITION_START);
-            else if (button_is_pressed(BUTTON_ON))
-                tractor_set_ignition_position(IGNITION_ON);
-            else
-                tractor_set_ignition_position(IGNITION_OFF);
-
-            // Update tractor model
-            bool led_status;
-            tractor_set_engine_speed_setpoint(ENGINE_SPEED_IDLE +
-                    ((adc_value_throttle - ADC_THROTTLE_IDLE) >> 1));
-            led_status = tractor_update_model();
-
-            // Update outputs to slave ECU
-            output_set_led(led_status);
-            output_set_dc_motor_pwm(tractor_get_engine_speed());
+        if (control_is_model_update_due()) {
+            control_update_model(adc_value[ADC_READ_THROTTLE],
+                    adc_value[ADC_READ_BUTTONS]);
 
-            // Start ADC reading to have values ready on the next loop
+            // Start ADC scan to have values ready on the next loop
             adc_start_conversion(ADC_READ_THROTTLE);
         }
         update_audio_sample = false;
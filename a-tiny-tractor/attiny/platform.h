@@ -0,0 +1,36 @@
+/**
+ *  @file platform.h
+ *  @author William Spinelli <william.spinelli(on)gmail>
+ *
+ *  @brief Helpers to build the firmware modules both on AVR and natively.
+ *
+ *  On AVR the constant tables are stored in PROGMEM and have to be read with
+ *  the pgm_read_* functions, while the native builds (simulator, benchmarks
+ *  and tools) read them as plain arrays.
+ *
+ *  The state of the modules is declared with @a MODULE_STATE.  On AVR it is
+ *  plain static storage, while in the native builds it is thread local, so
+ *  that every thread runs its own independent instance of the modules.
+ */
+
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+
+#define AVR_PGM_READ_BYTE(A) pgm_read_byte(&(A))
+
+#define MODULE_STATE static
+#else
+#include <string.h>
+
+#define PROGMEM
+#define memcpy_P memcpy
+
+#define AVR_PGM_READ_BYTE(A) (A)
+
+#define MODULE_STATE static _Thread_local
+#endif
+
+#endif
@@ -0,0 +1,97 @@
+/**
+ *  @file ram_monitor.c
+ *  @author William Spinelli <william.spinelli(on)gmail>
+ *  @brief Implementation for the functions defined in ram_monitor.h.
+ *  @warning Members listed here are intended for internal use only and should
+ *  not be used directly!
+ */
+
+#include "ram_monitor.h"
+
+#ifdef __AVR__
+#include <avr/io.h>
+
+/**
+ *  @brief End of .bss (start of the free RAM), defined by the linker.
+ */
+extern uint8_t _end;
+
+/**
+ *  @brief Top of the stack (RAMEND), defined by the linker.
+ */
+extern uint8_t __stack;
+
+/**
+ *  @brief Minimum free RAM measured so far.
+ */
+static uint16_t ram_free = 0;
+
+/**
+ *  @def RAM_MONITOR_STRINGIFY
+ *  @brief Expand a macro and turn it into a string literal, in order to use
+ *  it inside an inline assembly template.
+ */
+#define RAM_MONITOR_STRINGIFY(x)    RAM_MONITOR_STRINGIFY_(x)
+#define RAM_MONITOR_STRINGIFY_(x)   #x
+
+/**
+ *  @brief Paint the free RAM with RAM_MONITOR_PAINT.
+ *
+ *  This function is placed in the .init3 section, so that it is run inline
+ *  by the startup code after the stack pointer and the zero register have
+ *  been set up and before main is called, while the stack is still empty.
+ *  Being naked and never called, it has no prologue, no epilogue and no
+ *  return: GCC only supports basic assembly in naked functions, so the whole
+ *  loop is written in assembly (like __do_clear_bss in libgcc) and only uses
+ *  the call-clobbered registers r24, r25 and Z, never the stack.
+ */
+void ram_monitor_paint(void) __attribute__((naked, used, section(".init3")));
+
+void ram_monitor_paint(void)
+{
+    __asm__ __volatile__ (
+        "    ldi r30, lo8(_end)\n"
+        "    ldi r31, hi8(_end)\n"
+        "    ldi r24, " RAM_MONITOR_STRINGIFY(RAM_MONITOR_PAINT) "\n"
+        "    ldi r25, hi8(__stack + 1)\n"
+        "    rjmp 2f\n"
+        "1:  st Z+, r24\n"
+        "2:  cpi r30, lo8(__stack + 1)\n"
+        "    cpc r31, r25\n"
+        "    brlo 1b\n"
+    );
+}
+
+void ram_monitor_update(void)
+{
+    /*
+     * Until the first scan the limit is the whole painted area.  The
+     * .bss clear (done after the painting) sets ram_free to 0.
+     */
+    uint16_t limit = ram_free ? ram_free : (uint16_t)(&__stack - &_end + 1);
+    const uint8_t *p = &_end;
+    uint16_t free_bytes = 0;
+    while (free_bytes < limit && *p == RAM_MONITOR_PAINT) {
+        ++p;
+        ++free_bytes;
+    }
+    ram_free = free_bytes;
+
+    GPIOR1 = (uint8_t)free_bytes;
+    GPIOR2 = (uint8_t)(free_bytes >> 8);
+}
+
+uint16_t ram_monitor_get_free(void)
+{
+    return ram_free;
+}
+#else
+void ram_monitor_update(void)
+{
+}
+
+uint16_t ram_monitor_get_free(void)
+{
+    return 0;
+}
+#endif
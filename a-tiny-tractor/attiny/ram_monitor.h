@@ -0,0 +1,52 @@
+/**
+ *  @file ram_monitor.h
+ *  @author William Spinelli <william.spinelli(on)gmail>
+ *
+ *  @brief Measure the RAM headroom left by the stack.
+ *
+ *  The ATtiny85 has only 512 bytes of SRAM, shared by the module variables
+ *  (.data and .bss) and by the stack, that grows downwards from the end of
+ *  the RAM and also hosts the ISR frames.  In order to know how much RAM is
+ *  really left, the area between the end of .bss and the top of the stack is
+ *  painted with a known pattern at boot (before main is called), and the
+ *  lowest address ever reached by the stack is found looking for the first
+ *  byte that doesn't hold the pattern anymore (high-water mark).
+ *
+ *  The scan is cheap but not free, so it is meant to be called at a slow rate
+ *  (once per second).  The result is also written in GPIOR1 (low byte) and
+ *  GPIOR2 (high byte), where it can be read without any firmware support by
+ *  an emulator harness.
+ *
+ *  On the native builds there is no stack to monitor and the module reports
+ *  no free RAM at all.
+ */
+
+#ifndef RAM_MONITOR_H
+#define RAM_MONITOR_H
+
+#include <stdint.h>
+
+/**
+ *  @def RAM_MONITOR_PAINT
+ *  @brief The pattern painted in the free RAM at boot.
+ */
+#define RAM_MONITOR_PAINT       0xC5
+
+/**
+ *  @brief Update the high-water mark of the stack.
+ *
+ *  This function scans the painted area from the end of .bss upwards until
+ *  the first byte overwritten by the stack.  Since the free area can only
+ *  shrink, the scan stops at the previous high-water mark.
+ *  @note This function should be called every second.
+ */
+void ram_monitor_update(void);
+
+/**
+ *  @brief Get the minimum free RAM measured so far.
+ *  @return The number of bytes never touched by the stack (0 means that the
+ *  stack reached the module variables).
+ */
+uint16_t ram_monitor_get_free(void);
+
+#endif
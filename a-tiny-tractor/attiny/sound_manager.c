@@ -1,207 +1,613 @@
-/**
- *  @file sound_manager.c
- *  @author William Spinelli <william.spinelli(on)gmail>
- *  @brief Implementation for the functions defined in sound_manager.h.
- *  @warning Members listed here are intended for internal use only and should
- *  not be used directly!
- */
-
-#include "sound_manager.h"
-#include "tractor_model.h"
-
-#include "engine_running.h"
-#include "tractor_horn.h"
-
-#ifdef __AVR__
-#define AVR_PGM_READ_BYTE(A) pgm_read_byte(&(A))
-#else
-#include <string.h>
-#define memcpy_P memcpy
-
-#define AVR_PGM_READ_BYTE(A) (A)
-#endif
-
-/**
- *  @brief Duration for each note in a horn song.
- *
- *  This constant holds the note duration as a multiple of the audio manager
- *  update period TRACTOR_STATUS_UPDATE_CYCLE.
- */
-static const uint8_t HORN_NOTE_DURATION = 160 / TRACTOR_STATUS_UPDATE_CYCLE;
-
-/**
- *  @brief Duration for each pause (note 0) in a horn song.
- *
- *  This constant holds the pause duration as a multiple of the audio manager
- *  update period TRACTOR_STATUS_UPDATE_CYCLE.
- */
-static const uint8_t HORN_PAUSE_DURATION = 40 / TRACTOR_STATUS_UPDATE_CYCLE;
-
-/**
- *  @def MAX_SONG_SIZE
- *  @brief The maximum size for a horn song.
- */
-#define MAX_SONG_SIZE       30
-
-/**
- *  @brief Structure holding the details of a horn song.
- */
-typedef struct {
-    uint8_t size;                   /**< The actual size of the song. */
-    uint8_t note[MAX_SONG_SIZE];    /**< Array containing the song notes. */
-} Song;
-
-/**
- *  @def SONG
- *  @brief Variadic macro used to initialize song size and notes.
- *
- *  This macro is used to generate the song
- */
-#define SONG(...) \
-{sizeof((uint8_t[]){__VA_ARGS__}), {__VA_ARGS__}}
-
-/**
- *  @brief Structure holding the collection of all the horn songs.
- */
-static const Song SONG_LIBRARY[] PROGMEM = {
-    SONG(64, 64, 64),
-    SONG(64, 64, 0, 64, 64),
-    SONG(64, 80, 64, 64, 0, 64, 64, 0, 64, 72, 80, 85,
-            96, 96, 0, 96, 96, 0, 96, 96, 0, 80, 80),
-};
-
-/**
- *  @brief Structure holding the details of the current song.
- *
- *  This structure contains some redundant information (e.g. the field #song is
- *  a RAM copy of the current song from @a SONG_LIBRARY, or the field
- *  @a index_increment could be obtained indexing the @a note field in
- *  @a song).  This is done in order to simplify access to PROGMEM or to
- *  improve performance.
- */
-typedef struct {
-    Song    song;               /**< The current horn song. */
-    uint8_t current_note;       /**< The index of the current note. */
-    uint8_t note_counter;       /**< The counter used to manage note and pause duration. */
-    uint8_t index_increment;    /**< The current index increment. */
-    bool    playing;            /**< Whether a horn song is being played. */
-} Horn;
-
-/**
- *  @brief Details of the current song.
- */
-static Horn horn = {
-    .song               = {0, {0}},
-    .current_note       = 0,
-    .note_counter       = 0,
-    .index_increment    = 0,
-    .playing            = false,
-};
-
-/**
- * @brief Structure holding the index of the audio samples.
- */
-typedef struct {
-    uint16_t    engine;     /**< Index of the engine audio sample. */
-    uint16_t    horn;       /**< Index of the horn audio sample. */
-} SampleIndex;
-
-/**
- *  @brief Index of the current audio sample.
- */
-static SampleIndex sample_index = {
-    .engine = 0,
-    .horn   = 0,
-};
-
-uint8_t audio_get_next_sample(uint8_t engine_speed)
-{
-    uint8_t engine_sample;
-    if (engine_speed) {
-        /*
-         * The counter used for the engine track has a precision of 4 bits to
-         * allow 16 different audio frequency per unit
-         * Since the engine speed covers a range of
-         *      (2100 - 800) / 800 = 1.62
-         * this allows to simulate ~25 different speed values in the operating
-         * range (plus 16 below the idle speed).
-         */
-        sample_index.engine += (engine_speed >> 2);
-        if (sample_index.engine >= (ENGINE_RUNNING_SIZE << 4))
-            sample_index.engine -= (ENGINE_RUNNING_SIZE << 4);
-        uint16_t index = (sample_index.engine >> 4);
-        uint8_t offset = (uint8_t)(sample_index.engine & 0x000F);
-        if (offset < 16)
-            engine_sample = AVR_PGM_READ_BYTE(ENGINE_RUNNING[index]);
-        else if (offset < 48)
-            engine_sample = (AVR_PGM_READ_BYTE(ENGINE_RUNNING[index]) >> 1) +
-                    (AVR_PGM_READ_BYTE(ENGINE_RUNNING[index + 1]) >> 1);
-        else
-            engine_sample = AVR_PGM_READ_BYTE(ENGINE_RUNNING[index + 1]);
-    } else {
-        sample_index.engine = 0;
-        engine_sample = 128;
-    }
-
-    uint8_t horn_sample;
-    if (horn.playing && horn.index_increment) {
-        /*
-         * The counter used for the engine track has a precision of 6 bits to
-         * allow 64 different audio frequency per octave.
-         * Having an index_increment equal to 0 while a song is being played
-         * is used to insert pauses between the notes.
-         */
-        sample_index.horn += horn.index_increment;
-        if (sample_index.horn >= (TRACTOR_HORN_SIZE << 6))
-            sample_index.horn -= (TRACTOR_HORN_SIZE << 6);
-        uint16_t index = (sample_index.horn >> 6);
-        uint8_t offset = (uint8_t)(sample_index.horn & 0x003F);
-        if (offset < 16)
-            horn_sample = AVR_PGM_READ_BYTE(TRACTOR_HORN[index]);
-        else if (offset < 48)
-            horn_sample = (AVR_PGM_READ_BYTE(TRACTOR_HORN[index]) >> 1) +
-                    (AVR_PGM_READ_BYTE(TRACTOR_HORN[index + 1]) >> 1);
-        else
-            horn_sample = AVR_PGM_READ_BYTE(TRACTOR_HORN[index + 1]);
-    } else {
-        sample_index.horn = 0;
-        horn_sample = 128;
-    }
-
-    /*
-     * Mix the sounds adding the engine track to the horn track with offset of
-     * 128 removed, and saturating the output between 0 and 255.
-     */
-    int16_t sample = (int16_t)engine_sample + horn_sample - 128;
-    if (sample > UINT8_MAX)
-        sample = UINT8_MAX;
-    else if (sample < 0)
-        sample = 0;
-    return (uint8_t)sample;
-}
-
-void audio_play_horn_song(uint8_t song)
-{
-    if (song < SONG_COUNT) {
-        memcpy_P(&horn.song, &SONG_LIBRARY[song], sizeof(Song));
-        horn.current_note       = 0;
-        horn.note_counter       = 0;
-        horn.index_increment    = horn.song.note[0];
-        horn.playing            = true;
-    }
-}
-
-void audio_horn_manager(void)
-{
-    if (horn.playing) {
-        uint8_t duration = horn.index_increment ?
-                HORN_NOTE_DURATION : HORN_PAUSE_DURATION;
-        if (++horn.note_counter >= duration) {
-            horn.note_counter = 0;
-            if (++horn.current_note > horn.song.size)
-                horn.playing = false;
-        }
-
-        horn.index_increment = horn.song.note[horn.current_note];
-    }
-}
+/**
+ *  @file sound_manager.c
+ *  @author William Spinelli <william.spinelli(on)gmail>
+ *  @brief Implementation for the functions defined in sound_manager.h.
+ *  @warning Members listed here are intended for internal use only and should
+ *  not be used directly!
+ */
+
+#include "sound_manager.h"
+#include "tractor_model.h"
+#include "platform.h"
+#include "trace.h"
+
+#include "engine_running.h"
+#include "tractor_horn.h"
+
+/**
+ *  @brief Duration for each note in a horn song.
+ *
+ *  This constant holds the note duration as a multiple of the audio manager
+ *  update period TRACTOR_STATUS_UPDATE_CYCLE.
+ */
+static const uint8_t HORN_NOTE_DURATION = 160 / TRACTOR_STATUS_UPDATE_CYCLE;
+
+/**
+ *  @brief Duration for each pause (note 0) in a horn song.
+ *
+ *  This constant holds the pause duration as a multiple of the audio manager
+ *  update period TRACTOR_STATUS_UPDATE_CYCLE.
+ */
+static const uint8_t HORN_PAUSE_DURATION = 40 / TRACTOR_STATUS_UPDATE_CYCLE;
+
+/**
+ *  @def MAX_SONG_SIZE
+ *  @brief The maximum size for a horn song.
+ */
+#define MAX_SONG_SIZE       30
+
+/**
+ *  @def HORN_VOICES
+ *  @brief The maximum number of horn voices played together (chord).
+ */
+#define HORN_VOICES         3
+
+/**
+ *  @brief Structure holding the details of a horn song.
+ *
+ *  Each note of the song is played by @a voices horn voices at the same time:
+ *  the note itself, its major third and its fifth.  The voices share the
+ *  same horn track, played back at different speeds.
+ */
+typedef struct {
+    uint8_t size;                   /**< The actual size of the song. */
+    uint8_t voices;                 /**< The number of voices (1 to HORN_VOICES). */
+    uint8_t note[MAX_SONG_SIZE];    /**< Array containing the song notes. */
+} Song;
+
+/**
+ *  @def SONG
+ *  @brief Variadic macro used to initialize song voices, size and notes.
+ *
+ *  This macro is used to generate the song
+ */
+#define SONG(voices, ...) \
+{sizeof((uint8_t[]){__VA_ARGS__}), voices, {__VA_ARGS__}}
+
+/**
+ *  @brief Structure holding the collection of all the horn songs.
+ *
+ *  The honks are played as chords (like a real air horn), while "Dixie"
+ *  is played with a single voice.
+ */
+static const Song SONG_LIBRARY[] PROGMEM = {
+    SONG(3, 64, 64, 64),
+    SONG(2, 64, 64, 0, 64, 64),
+    SONG(1, 64, 80, 64, 64, 0, 64, 64, 0, 64, 72, 80, 85,
+            96, 96, 0, 96, 96, 0, 96, 96, 0, 80, 80),
+};
+
+/**
+ *  @brief Right shift applied to each horn voice, by number of voices.
+ *
+ *  The horn voices are scaled down before being summed, so that the weights
+ *  of the voices always sum up to 1 and the chord never exceeds the range of
+ *  a single voice (the root note is kept louder than the other voices).
+ */
+static const uint8_t HORN_VOICE_SHIFT[HORN_VOICES][HORN_VOICES] PROGMEM = {
+    {0, 0, 0},
+    {1, 1, 0},
+    {1, 2, 2},
+};
+
+/**
+ *  @brief Enumeration of the stages of the horn envelope.
+ */
+enum {
+    HORN_STAGE_OFF,     /**< The horn is silent. */
+    HORN_STAGE_HOLD,    /**< A note is held: attack, then sustain loop. */
+    HORN_STAGE_RELEASE, /**< The note is over: release tail until the end. */
+};
+
+/**
+ *  @brief Structure holding the details of the current song.
+ *
+ *  This structure contains some redundant information (e.g. the field #song is
+ *  a RAM copy of the current song from @a SONG_LIBRARY, or the field
+ *  @a index_increment could be obtained indexing the @a note field in
+ *  @a song).  This is done in order to simplify access to PROGMEM or to
+ *  improve performance.
+ */
+typedef struct {
+    Song    song;               /**< The current horn song. */
+    uint8_t current_note;       /**< The index of the current note. */
+    uint8_t note_counter;       /**< The counter used to manage note and pause duration. */
+    uint8_t index_increment;    /**< The current index increment. */
+    uint8_t voice_increment[HORN_VOICES];   /**< The index increment of each voice. */
+    uint8_t voice_shift[HORN_VOICES];       /**< The right shift of each voice. */
+    uint8_t stage;              /**< The stage of the envelope (HORN_STAGE_OFF...). */
+    bool    playing;            /**< Whether a horn song is being played. */
+} Horn;
+
+/**
+ *  @def HORN_INITIAL_STATE
+ *  @brief Initializer for the details of the current song (no song).
+ */
+#define HORN_INITIAL_STATE {            \
+    .song               = {0, 1, {0}},  \
+    .current_note       = 0,            \
+    .note_counter       = 0,            \
+    .index_increment    = 0,            \
+    .voice_increment    = {0, 0, 0},    \
+    .voice_shift        = {0, 0, 0},    \
+    .stage              = HORN_STAGE_OFF, \
+    .playing            = false,        \
+}
+
+/**
+ *  @brief Details of the current song.
+ */
+MODULE_STATE Horn horn = HORN_INITIAL_STATE;
+
+/**
+ * @brief Structure holding the index of the audio samples.
+ */
+typedef struct {
+    uint16_t    engine;     /**< Index of the engine audio sample. */
+    uint16_t    horn[HORN_VOICES];  /**< Index of the horn audio sample of each voice. */
+} SampleIndex;
+
+/**
+ *  @def SAMPLE_INDEX_INITIAL_STATE
+ *  @brief Initializer for the index of the audio samples.
+ */
+#define SAMPLE_INDEX_INITIAL_STATE {    \
+    .engine = 0,                        \
+    .horn   = {0, 0, 0},                \
+}
+
+/**
+ *  @brief Index of the current audio sample.
+ */
+MODULE_STATE SampleIndex sample_index = SAMPLE_INDEX_INITIAL_STATE;
+
+#ifdef AUDIO_GRANULAR_ENGINE
+
+/**
+ *  @def GRAIN_SIZE
+ *  @brief The length of an engine grain in samples (16 ms).
+ */
+#define GRAIN_SIZE          128
+
+/**
+ *  @def GRAIN_HOP
+ *  @brief The distance in samples between the start of consecutive grains.
+ *
+ *  Consecutive grains are taken from the engine track every GRAIN_HOP
+ *  samples.  At idle speed they are also triggered every GRAIN_HOP samples,
+ *  so the track is rebuilt as it was recorded.
+ */
+#define GRAIN_HOP           96
+
+/**
+ *  @def GRAIN_VOICES
+ *  @brief The number of grains that can be played at the same time.
+ *
+ *  The grain overlap is GRAIN_SIZE / GRAIN_HOP * engine_speed / 64, that is
+ *  up to 3.5 grains at the maximum engine speed.
+ */
+#define GRAIN_VOICES        4
+
+/**
+ *  @def GRAIN_TRIGGER_PERIOD
+ *  @brief Threshold of the grain trigger accumulator.
+ *
+ *  The accumulator is incremented by the engine speed every sample, so a
+ *  grain is triggered every GRAIN_HOP samples at idle speed (64) and faster
+ *  as the engine speed grows.
+ */
+#define GRAIN_TRIGGER_PERIOD    (GRAIN_HOP << 6)
+
+/**
+ *  @def GRAIN_WINDOW_COUNT
+ *  @brief The number of grain windows, one for each engine load.
+ */
+#define GRAIN_WINDOW_COUNT  4
+
+/**
+ *  @brief Windows applied to the grains, in steps of 8 samples.
+ *
+ *  Each entry is a gain in eighths, applied with shifts (see
+ *  apply_grain_window).  The window for no load ramps up and down in 32
+ *  samples (GRAIN_SIZE - GRAIN_HOP) with complementary steps, so that
+ *  overlapping grains at idle speed always add up to unity gain.  The windows
+ *  for higher loads have steeper ramps: the overlaps add up to more than
+ *  unity, accenting every firing with a rougher edge.
+ */
+static const uint8_t GRAIN_WINDOW[GRAIN_WINDOW_COUNT][GRAIN_SIZE >> 3] PROGMEM = {
+    {1, 3, 5, 7, 8, 8, 8, 8, 8, 8, 8, 8, 7, 5, 3, 1},
+    {3, 5, 7, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 7, 5, 3},
+    {5, 7, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 7, 5},
+    {8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8},
+};
+
+/**
+ *  @brief Structure holding the status of a grain voice.
+ */
+typedef struct {
+    uint16_t    position;   /**< Index of the next engine sample to play. */
+    uint8_t     age;        /**< Samples played so far (GRAIN_SIZE when idle). */
+} GrainVoice;
+
+/**
+ *  @brief Structure holding the status of the granular engine synthesis.
+ */
+typedef struct {
+    GrainVoice  voice[GRAIN_VOICES];    /**< The grain voices. */
+    uint16_t    trigger;                /**< The grain trigger accumulator. */
+    uint16_t    next_position;          /**< Start of the next grain. */
+    uint8_t     next_voice;             /**< Voice used by the next grain. */
+    const uint8_t *window;              /**< The grain window for the engine load. */
+} Granular;
+
+/**
+ *  @def GRANULAR_INITIAL_STATE
+ *  @brief Initializer for the granular engine synthesis (no grain playing).
+ */
+#define GRANULAR_INITIAL_STATE {                        \
+    .voice          = {                                 \
+        {0, GRAIN_SIZE}, {0, GRAIN_SIZE},               \
+        {0, GRAIN_SIZE}, {0, GRAIN_SIZE},               \
+    },                                                  \
+    .trigger        = GRAIN_TRIGGER_PERIOD,             \
+    .next_position  = 0,                                \
+    .next_voice     = 0,                                \
+    .window         = GRAIN_WINDOW[0],                  \
+}
+
+/**
+ *  @brief Status of the granular engine synthesis.
+ */
+MODULE_STATE Granular granular = GRANULAR_INITIAL_STATE;
+
+/**
+ *  @brief Apply a window gain (in eighths) to a signed sample.
+ *  @param sample The sample with the offset of 128 removed.
+ *  @param gain The gain in eighths (0 to 8).
+ *  @return The scaled sample.
+ */
+static inline int16_t apply_grain_window(int16_t sample, uint8_t gain)
+{
+    if (gain & 0x08)
+        return sample;
+
+    int16_t result = 0;
+    if (gain & 0x04)
+        result += sample >> 1;
+    if (gain & 0x02)
+        result += sample >> 2;
+    if (gain & 0x01)
+        result += sample >> 3;
+    return result;
+}
+
+/**
+ *  @brief Compute the next engine sample overlapping windowed grains.
+ *
+ *  Grains are always played back at the original speed, so the pitch of the
+ *  engine track does not change, while they are triggered at a rate
+ *  proportional to the engine speed, so the firing rate does.
+ *  @param engine_speed The current engine speed (not 0).
+ *  @return The engine sample with the offset of 128 removed.
+ */
+static inline int16_t get_granular_engine_sample(uint8_t engine_speed)
+{
+    granular.trigger += engine_speed;
+    if (granular.trigger >= GRAIN_TRIGGER_PERIOD) {
+        granular.trigger -= GRAIN_TRIGGER_PERIOD;
+
+        GrainVoice *voice = &granular.voice[granular.next_voice];
+        voice->position = granular.next_position;
+        voice->age      = 0;
+        granular.next_voice = (granular.next_voice + 1) & (GRAIN_VOICES - 1);
+
+        granular.next_position += GRAIN_HOP;
+        if (granular.next_position > ENGINE_RUNNING_LOOP_END - GRAIN_SIZE)
+            granular.next_position = ENGINE_RUNNING_LOOP_START;
+    }
+
+    int16_t sample = 0;
+    for (uint8_t i = 0; i < GRAIN_VOICES; ++i) {
+        GrainVoice *voice = &granular.voice[i];
+        if (voice->age < GRAIN_SIZE) {
+            int16_t grain = (int16_t)AVR_PGM_READ_BYTE(
+                    ENGINE_RUNNING[voice->position]) - 128;
+            sample += apply_grain_window(grain,
+                    AVR_PGM_READ_BYTE(granular.window[voice->age >> 3]));
+            ++voice->position;
+            ++voice->age;
+        }
+    }
+    return sample;
+}
+
+#else
+
+/**
+ *  @def ENGINE_LOAD_COUNT
+ *  @brief The number of engine loads mapped to an engine loop.
+ */
+#define ENGINE_LOAD_COUNT   4
+
+/**
+ *  @def ENGINE_LOADED_LOOP_START
+ *  @brief Start of the engine loop used while the engine is working hard.
+ *
+ *  The loaded loop is a single firing period (about 100 ms) around the
+ *  strongest firing of the engine track, with matching samples at both ends
+ *  so that the seam doesn't click.
+ */
+#define ENGINE_LOADED_LOOP_START    2807
+
+/**
+ *  @def ENGINE_LOADED_LOOP_END
+ *  @brief End of the engine loop used while the engine is working hard.
+ */
+#define ENGINE_LOADED_LOOP_END      3614
+
+/**
+ *  @brief Structure holding the loop of the engine track.
+ */
+typedef struct {
+    uint16_t    end;        /**< End of the loop (BP4 index). */
+    uint16_t    length;     /**< Length of the loop (BP4 index). */
+} EngineLoop;
+
+/**
+ *  @def ENGINE_LOOP
+ *  @brief Initializer for an engine loop given its start and end samples.
+ */
+#define ENGINE_LOOP(start, end)     {(end) << 4, ((end) - (start)) << 4}
+
+/**
+ *  @brief Loop of the engine track, for each engine load.
+ *
+ *  At steady speed the whole engine track is looped, while at the highest
+ *  loads the loaded loop repeats its strongest firing, giving a harsher,
+ *  working hard sound while the engine accelerates.
+ */
+static const EngineLoop ENGINE_LOOP_BY_LOAD[ENGINE_LOAD_COUNT] PROGMEM = {
+    ENGINE_LOOP(ENGINE_RUNNING_LOOP_START, ENGINE_RUNNING_LOOP_END),
+    ENGINE_LOOP(ENGINE_RUNNING_LOOP_START, ENGINE_RUNNING_LOOP_END),
+    ENGINE_LOOP(ENGINE_LOADED_LOOP_START, ENGINE_LOADED_LOOP_END),
+    ENGINE_LOOP(ENGINE_LOADED_LOOP_START, ENGINE_LOADED_LOOP_END),
+};
+
+/**
+ *  @brief Current loop of the engine track.
+ *
+ *  The loop is chosen once per model update (see audio_set_engine_load), so
+ *  the engine sample only compares its index with a different bound.
+ */
+MODULE_STATE EngineLoop engine_loop =
+        ENGINE_LOOP(ENGINE_RUNNING_LOOP_START, ENGINE_RUNNING_LOOP_END);
+
+#endif
+
+/**
+ *  @def HORN_RELEASE_END
+ *  @brief The BP6 index where the release tail of the horn track ends.
+ *
+ *  The last sample is excluded, since it is interpolated with the next one.
+ */
+#define HORN_RELEASE_END    ((TRACTOR_HORN_SIZE - 1) << 6)
+
+/**
+ *  @brief Compute the next sample of a horn voice.
+ *
+ *  While the note is held the voice plays the attack once, then loops on the
+ *  sustain region [TRACTOR_HORN_LOOP_START, TRACTOR_HORN_LOOP_END).  When the
+ *  note is released it continues into the release tail, and stays silent
+ *  after the end of the track.
+ *  @param index The BP6 index of the voice in the horn track.
+ *  @param increment The index increment of the voice.
+ *  @param hold Whether the note is held (sustain loop enabled).
+ *  @return The horn sample of the voice.
+ */
+static inline uint8_t get_horn_voice_sample(uint16_t *index, uint8_t increment,
+        bool hold)
+{
+    /*
+     * The counter used for the horn track has a precision of 6 bits to
+     * allow 64 different audio frequency per octave.
+     */
+    *index += increment;
+    if (hold) {
+        if (*index >= (TRACTOR_HORN_LOOP_END << 6))
+            *index -= ((TRACTOR_HORN_LOOP_END - TRACTOR_HORN_LOOP_START) << 6);
+    } else if (*index >= HORN_RELEASE_END) {
+        *index = HORN_RELEASE_END;
+        return 128;
+    }
+    uint16_t sample_index = (*index >> 6);
+    uint8_t offset = (uint8_t)(*index & 0x003F);
+    if (offset < 16)
+        return AVR_PGM_READ_BYTE(TRACTOR_HORN[sample_index]);
+    else if (offset < 48)
+        return (AVR_PGM_READ_BYTE(TRACTOR_HORN[sample_index]) >> 1) +
+                (AVR_PGM_READ_BYTE(TRACTOR_HORN[sample_index + 1]) >> 1);
+    else
+        return AVR_PGM_READ_BYTE(TRACTOR_HORN[sample_index + 1]);
+}
+
+/**
+ *  @brief Set the note played by the horn voices.
+ *
+ *  The increments of the chord voices are derived from the note using only
+ *  shifts: the major third is 5/4 of the note and the fifth is 3/2 of it.
+ *  A note following silence (or a release) restarts from the attack, while a
+ *  note following another one keeps the voices in the sustain loop (legato).
+ *  A pause releases the current note, which keeps its increments until the
+ *  end of the release tail.
+ *  @param note The index increment of the note (0 for a pause).
+ */
+static void set_horn_note(uint8_t note)
+{
+    horn.index_increment = note;
+    if (!note) {
+        if (horn.stage == HORN_STAGE_HOLD)
+            horn.stage = HORN_STAGE_RELEASE;
+        return;
+    }
+
+    if (horn.stage != HORN_STAGE_HOLD) {
+        for (uint8_t i = 0; i < HORN_VOICES; ++i)
+            sample_index.horn[i] = 0;
+        horn.stage = HORN_STAGE_HOLD;
+    }
+    horn.voice_increment[0] = note;
+    horn.voice_increment[1] = note + (note >> 2);
+    horn.voice_increment[2] = note + (note >> 1);
+}
+
+uint8_t audio_get_next_sample(uint8_t engine_speed)
+{
+    TRACE_BEGIN("audio_get_next_sample");
+
+    uint8_t engine_sample;
+#ifdef AUDIO_GRANULAR_ENGINE
+    if (engine_speed) {
+        int16_t sample = get_granular_engine_sample(engine_speed) + 128;
+        if (sample > UINT8_MAX)
+            sample = UINT8_MAX;
+        else if (sample < 0)
+            sample = 0;
+        engine_sample = (uint8_t)sample;
+    } else {
+        /*
+         * While the engine runs the trigger accumulator always stays below
+         * GRAIN_TRIGGER_PERIOD, so the grains are only reset on the first
+         * sample after the engine stops, not on every silent sample.
+         */
+        if (granular.trigger != GRAIN_TRIGGER_PERIOD)
+            granular = (Granular)GRANULAR_INITIAL_STATE;
+        engine_sample = 128;
+    }
+#else
+    if (engine_speed) {
+        /*
+         * The counter used for the engine track has a precision of 4 bits to
+         * allow 16 different audio frequency per unit
+         * Since the engine speed covers a range of
+         *      (2100 - 800) / 800 = 1.62
+         * this allows to simulate ~25 different speed values in the operating
+         * range (plus 16 below the idle speed).
+         */
+        sample_index.engine += (engine_speed >> 2);
+        if (sample_index.engine >= engine_loop.end)
+            sample_index.engine -= engine_loop.length;
+        uint16_t index = (sample_index.engine >> 4);
+        uint8_t offset = (uint8_t)(sample_index.engine & 0x000F);
+        if (offset < 16)
+            engine_sample = AVR_PGM_READ_BYTE(ENGINE_RUNNING[index]);
+        else if (offset < 48)
+            engine_sample = (AVR_PGM_READ_BYTE(ENGINE_RUNNING[index]) >> 1) +
+                    (AVR_PGM_READ_BYTE(ENGINE_RUNNING[index + 1]) >> 1);
+        else
+            engine_sample = AVR_PGM_READ_BYTE(ENGINE_RUNNING[index + 1]);
+    } else {
+        sample_index.engine = 0;
+        engine_sample = 128;
+    }
+#endif
+
+    uint8_t horn_sample;
+    if (horn.stage != HORN_STAGE_OFF) {
+        /*
+         * Having an index_increment equal to 0 while a song is being played
+         * is used to insert pauses between the notes, where the previous
+         * note is released.
+         * The voices are scaled so that their weights sum up to 1, hence the
+         * chord is still centered on 128 and cannot overflow.
+         */
+        bool hold = (horn.stage == HORN_STAGE_HOLD);
+        horn_sample = 0;
+        for (uint8_t i = 0; i < horn.song.voices; ++i)
+            horn_sample += get_horn_voice_sample(&sample_index.horn[i],
+                    horn.voice_increment[i], hold) >> horn.voice_shift[i];
+
+        // the root note is the slowest voice, the last one to end
+        if (!hold && sample_index.horn[0] >= HORN_RELEASE_END)
+            horn.stage = HORN_STAGE_OFF;
+    } else {
+        horn_sample = 128;
+    }
+
+    /*
+     * Mix the sounds adding the engine track to the horn track with offset of
+     * 128 removed, and saturating the output between 0 and 255.
+     */
+    int16_t sample = (int16_t)engine_sample + horn_sample - 128;
+    if (sample > UINT8_MAX)
+        sample = UINT8_MAX;
+    else if (sample < 0)
+        sample = 0;
+
+    TRACE_END("audio_get_next_sample");
+    return (uint8_t)sample;
+}
+
+void audio_set_engine_load(uint8_t load)
+{
+#ifdef AUDIO_GRANULAR_ENGINE
+    if (load >= GRAIN_WINDOW_COUNT)
+        load = GRAIN_WINDOW_COUNT - 1;
+    granular.window = GRAIN_WINDOW[load];
+#else
+    if (load >= ENGINE_LOAD_COUNT)
+        load = ENGINE_LOAD_COUNT - 1;
+    memcpy_P(&engine_loop, &ENGINE_LOOP_BY_LOAD[load], sizeof(EngineLoop));
+#endif
+}
+
+void audio_play_horn_song(uint8_t song)
+{
+    if (song < SONG_COUNT) {
+        memcpy_P(&horn.song, &SONG_LIBRARY[song], sizeof(Song));
+        memcpy_P(horn.voice_shift, HORN_VOICE_SHIFT[horn.song.voices - 1],
+                sizeof(horn.voice_shift));
+        horn.current_note       = 0;
+        horn.note_counter       = 0;
+        horn.playing            = true;
+        horn.stage              = HORN_STAGE_OFF;   // restart from the attack
+        set_horn_note(horn.song.note[0]);
+    }
+}
+
+void audio_horn_manager(void)
+{
+    TRACE_BEGIN("audio_horn_manager");
+
+    if (horn.playing) {
+        uint8_t duration = horn.index_increment ?
+                HORN_NOTE_DURATION : HORN_PAUSE_DURATION;
+        if (++horn.note_counter >= duration) {
+            horn.note_counter = 0;
+            if (++horn.current_note > horn.song.size)
+                horn.playing = false;
+        }
+
+        // the end of the song releases the last note
+        set_horn_note(horn.playing ? horn.song.note[horn.current_note] : 0);
+    }
+
+    TRACE_COUNTER("horn_index_increment", horn.playing ? horn.index_increment : 0);
+    TRACE_END("audio_horn_manager");
+}
+
+uint8_t audio_get_horn_note(void)
+{
+    return horn.playing ? horn.index_increment : 0;
+}
+
+void audio_reset(void)
+{
+    horn = (Horn)HORN_INITIAL_STATE;
+    sample_index = (SampleIndex)SAMPLE_INDEX_INITIAL_STATE;
+#ifdef AUDIO_GRANULAR_ENGINE
+    granular = (Granular)GRANULAR_INITIAL_STATE;
+#else
+    engine_loop = (EngineLoop)ENGINE_LOOP(ENGINE_RUNNING_LOOP_START,
+            ENGINE_RUNNING_LOOP_END);
+#endif
+}
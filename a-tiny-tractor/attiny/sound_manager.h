@@ -1,85 +1,134 @@
-/**
- *  @file sound_manager.h
- *  @author William Spinelli <william.spinelli(on)gmail>
- *
- *  @brief Provide basic sound effects for a tractor model.
- *
- *  This module provides some Lo-Fi sound effects for a tractor model.  One new
- *  audio sample is generated every cycle, with a rate of 8 kHz (calling the
- *  function audio_get_next_sample).
- *
- *  There are two main audio tracks that can be played together:
- *   - an engine audio track
- *   - a horn audio track
- *  When the horn track is being played the volume of the engine track is
- *  lowered to make it easier to understand.
- *
- *  The tracks are stored as arrays (in PROGMEM on the ATtiny).  They can be
- *  generated from a mono WAV file with 8-bit unsigned samples using the Python
- *  script wav2c.py in the sound directory.
- *
- *  In order to simulate different engine speeds, the samples are played back
- *  at different speeds.  This is done using a BP4 (binary point 4) counter
- *  which is incremented in steps proportional to the engine speed.  A step
- *  increment of 16 means that the track is played back at original speed.
- *  A step increment of 40 means that the track is played back at 2.5x the
- *  original speed.
- *
- *  Based on the value of <em>index</em>, a rough sample interpolation is done
- *  choosing the closest value among:
- *   - <em>TRACK[floor(index)]</em>
- *   - <em>(TRACK[floor(index)] >> 1) + (TRACK[ceil(index)] >> 1)</em>
- *   - <em>TRACK[ceil(index)]</em>
- *
- *  The same idea is used for simulating different horn notes.  Here a BP6
- *  counter is used instead and the step increment is chosen according to the
- *  note that has to be played.  The same interpolation approach is used.
- *
- *  @warning This is probably neither the most effective way to playback a
- *  given soundwave on ATtiny, nor the one with the highest fidelity.  But I
- *  wanted to try out this approach to test out something new.  Also one target
- *  in this project was to completely avoid multiplication and division and
- *  rely only on left and right shifts. And in the end it was not that bad for
- *  its purpose =)
- */
-
-#ifndef SOUND_MANAGER_H
-#define SOUND_MANAGER_H
-
-#include <stdint.h>
-#include <stdbool.h>
-
-/**
- *  @brief Enumeration of the horn songs managed by this module.
- */
-enum {
-    SONG_SINGLE_HONK,   /**< Play a single honk with the horn. */
-    SONG_DOUBLE_HONK,   /**< Play a double honk with the horn. */
-    SONG_DIXIE,         /**< Play the "Dixie" song with the horn. */
-    SONG_COUNT,         /**< Total songs managed by the module. */
-};
-
-/**
- *  @brief Compute the next audio sample to play.
- *
- *  This function computes the next audio sample to play as a 8-bit unsigned
- *  sample.  The default output when no sound is being played is therefore 128.
- *  @param engine_speed The current engine speed.
- *  @return The next audio sample to play.
- *  @note This function has to be called every 125 us (8 kHz).
- */
-uint8_t audio_get_next_sample(uint8_t engine_speed);
-
-/**
- *  @brief Start (or restart) the playback of the given horn song.
- *  @param song The index of the horn song to play.
- */
-void audio_play_horn_song(uint8_t song);
-
-/**
- *  @brief Manage the playback of the horn track.
- *  @note This function has to be called every 40 ms.
- */
-void audio_horn_manager(void);
-
-#endif
+/**
+ *  @file sound_manager.h
+ *  @author William Spinelli <william.spinelli(on)gmail>
+ *
+ *  @brief Provide basic sound effects for a tractor model.
+ *
+ *  This module provides some Lo-Fi sound effects for a tractor model.  One new
+ *  audio sample is generated every cycle, with a rate of 8 kHz (calling the
+ *  function audio_get_next_sample).
+ *
+ *  There are two main audio tracks that can be played together:
+ *   - an engine audio track
+ *   - a horn audio track
+ *  When the horn track is being played the volume of the engine track is
+ *  lowered to make it easier to understand.
+ *
+ *  The tracks are stored as arrays (in PROGMEM on the ATtiny).  They can be
+ *  generated from a mono WAV file with 8-bit unsigned samples using the Python
+ *  script wav2c.py in the sound directory.
+ *
+ *  In order to simulate different engine speeds, the samples are played back
+ *  at different speeds.  This is done using a BP4 (binary point 4) counter
+ *  which is incremented in steps proportional to the engine speed.  A step
+ *  increment of 16 means that the track is played back at original speed.
+ *  A step increment of 40 means that the track is played back at 2.5x the
+ *  original speed.
+ *
+ *  Based on the value of <em>index</em>, a rough sample interpolation is done
+ *  choosing the closest value among:
+ *   - <em>TRACK[floor(index)]</em>
+ *   - <em>(TRACK[floor(index)] >> 1) + (TRACK[ceil(index)] >> 1)</em>
+ *   - <em>TRACK[ceil(index)]</em>
+ *
+ *  The same idea is used for simulating different horn notes.  Here a BP6
+ *  counter is used instead and the step increment is chosen according to the
+ *  note that has to be played.  The same interpolation approach is used.
+ *  A horn song can also be played as a chord (like a two-tone air horn): up
+ *  to three voices, the note, its major third (5/4) and its fifth (3/2), run
+ *  their own BP6 counters over the same horn track and are summed after
+ *  being scaled down with shifts, so that the chord keeps the same range.
+ *
+ *  The tracks carry loop points (the LOOP_START and LOOP_END definitions
+ *  generated from the 'smpl' chunk of the WAV files): the samples before the
+ *  loop are the attack, the loop is the sustain and the samples after it are
+ *  the release.  A horn note plays the attack once, then repeats the sustain
+ *  loop while it is held and plays the release when the song pauses or ends,
+ *  so the horn track only needs one period of the steady tone instead of a
+ *  whole honk.  The engine track is a single loop.
+ *
+ *  Resampling the engine track changes its firing rate and its timbre at the
+ *  same time.  Building with AUDIO_GRANULAR_ENGINE defined replaces it with a
+ *  granular synthesis: short windowed grains (16 ms) taken in sequence from
+ *  the engine track are overlapped and always played at the original speed,
+ *  while the rate at which they are triggered is proportional to the engine
+ *  speed.  The window is a precomputed table of gains in eighths applied with
+ *  shifts, so each sample costs one table read per active grain (up to 4).
+ *  The engine load selects the window among a few rows, from a smooth one at
+ *  steady speed to sharper ones that accent every firing while the engine is
+ *  accelerating.  The row is chosen once per model update, so the load
+ *  changes the timbre without adding any work per sample.
+ *
+ *  The resampled engine uses the engine load to choose its loop instead: at
+ *  steady speed the whole engine track is looped, while the engine is working
+ *  hard the loop shrinks to the single strongest firing of the track.  The
+ *  loop is also chosen once per model update, so the mix is the same in both
+ *  builds.
+ *
+ *  @warning This is probably neither the most effective way to playback a
+ *  given soundwave on ATtiny, nor the one with the highest fidelity.  But I
+ *  wanted to try out this approach to test out something new.  Also one target
+ *  in this project was to completely avoid multiplication and division and
+ *  rely only on left and right shifts. And in the end it was not that bad for
+ *  its purpose =)
+ */
+
+#ifndef SOUND_MANAGER_H
+#define SOUND_MANAGER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ *  @brief Enumeration of the horn songs managed by this module.
+ */
+enum {
+    SONG_SINGLE_HONK,   /**< Play a single honk with the horn. */
+    SONG_DOUBLE_HONK,   /**< Play a double honk with the horn. */
+    SONG_DIXIE,         /**< Play the "Dixie" song with the horn. */
+    SONG_COUNT,         /**< Total songs managed by the module. */
+};
+
+/**
+ *  @brief Compute the next audio sample to play.
+ *
+ *  This function computes the next audio sample to play as a 8-bit unsigned
+ *  sample.  The default output when no sound is being played is therefore 128.
+ *  @param engine_speed The current engine speed.
+ *  @return The next audio sample to play.
+ *  @note This function has to be called every 125 us (8 kHz).
+ */
+uint8_t audio_get_next_sample(uint8_t engine_speed);
+
+/**
+ *  @brief Set the engine load used to shape the engine sound.
+ *  @param load The engine load (0 at steady speed, higher values while the
+ *  engine is working harder).
+ *  @note This function has to be called every 40 ms.
+ */
+void audio_set_engine_load(uint8_t load);
+
+/**
+ *  @brief Start (or restart) the playback of the given horn song.
+ *  @param song The index of the horn song to play.
+ */
+void audio_play_horn_song(uint8_t song);
+
+/**
+ *  @brief Manage the playback of the horn track.
+ *  @note This function has to be called every 40 ms.
+ */
+void audio_horn_manager(void);
+
+/**
+ *  @brief Get the note currently played by the horn.
+ *  @return The index increment of the current note (0 when silent).
+ */
+uint8_t audio_get_horn_note(void);
+
+/**
+ *  @brief Stop any playback and bring the module back to its initial state.
+ */
+void audio_reset(void);
+
+#endif
@@ -0,0 +1,83 @@
+/**
+ *  @file trace.h
+ *  @author William Spinelli <william.spinelli(on)gmail>
+ *
+ *  @brief Lightweight tracing hooks for the hot paths of the firmware.
+ *
+ *  The macros TRACE_BEGIN, TRACE_END and TRACE_COUNTER mark the beginning and
+ *  the end of a traced section and the value of a counter.  The name must be
+ *  a string literal.
+ *
+ *  On AVR, and in native builds that do not define TRACE_ENABLED, the macros
+ *  expand to nothing.  In native builds with TRACE_ENABLED they record events
+ *  in per-thread lock-free buffers (see the simulator trace recorder), that
+ *  can be exported in the Chrome trace JSON format.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#if !defined(__AVR__) && defined(TRACE_ENABLED)
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ *  @brief Start or stop recording events (recording is off at startup).
+ *  @param enabled Whether the events have to be recorded.
+ */
+void trace_enable(bool enabled);
+
+/**
+ *  @brief Set the name of the calling thread in the exported trace.
+ *  @param name The name of the thread.
+ */
+void trace_set_thread_name(const char *name);
+
+/**
+ *  @brief Record the beginning of a section on the calling thread.
+ *  @param name The name of the section (string literal).
+ */
+void trace_begin(const char *name);
+
+/**
+ *  @brief Record the end of a section on the calling thread.
+ *  @param name The name of the section (string literal).
+ */
+void trace_end(const char *name);
+
+/**
+ *  @brief Record the value of a counter.
+ *  @param name The name of the counter (string literal).
+ *  @param value The current value of the counter.
+ */
+void trace_counter(const char *name, int32_t value);
+
+/**
+ *  @brief Write all the recorded events in Chrome trace JSON format.
+ *  @param filename The name of the output file.
+ *  @return true on success.
+ */
+bool trace_write_json(const char *filename);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define TRACE_BEGIN(name)           trace_begin(name)
+#define TRACE_END(name)             trace_end(name)
+#define TRACE_COUNTER(name, value)  trace_counter(name, value)
+
+#else
+
+#define TRACE_BEGIN(name)
+#define TRACE_END(name)
+#define TRACE_COUNTER(name, value)
+
+#endif
+
+#endif
@@ -9,56 +9,40 @@
 #define PROGMEM
 #endif
 
-#define TRACTOR_HORN_SIZE 787
+/* [0, LOOP_START) attack, [LOOP_START, LOOP_END) sustain loop, then release */
+#define TRACTOR_HORN_SIZE 484
+#define TRACTOR_HORN_LOOP_START 121
+#define TRACTOR_HORN_LOOP_END 242
 static const uint8_t TRACTOR_HORN[TRACTOR_HORN_SIZE] PROGMEM = {
-130, 147, 141, 85, 121, 146, 85, 99, 159, 109, 108, 174, 134, 92, 154, 160, 
-68, 129, 197, 102, 135, 222, 126, 114, 192, 130, 91, 157, 143, 105, 130, 143, 
-157, 105, 101, 156, 112, 84, 151, 136, 96, 164, 158, 95, 131, 178, 94, 90, 
-193, 138, 97, 210, 171, 91, 174, 162, 89, 132, 159, 108, 119, 135, 152, 129, 
-85, 136, 133, 77, 119, 154, 95, 130, 172, 115, 100, 165, 133, 67, 154, 174, 
-90, 157, 208, 105, 130, 184, 108, 99, 155, 125, 103, 129, 141, 145, 92, 107, 
-149, 96, 86, 152, 120, 97, 168, 144, 88, 136, 171, 75, 100, 197, 117, 105, 
-220, 151, 94, 186, 146, 81, 140, 152, 98, 121, 137, 154, 116, 84, 146, 123, 
-72, 131, 149, 88, 145, 170, 100, 108, 181, 114, 69, 181, 160, 86, 186, 199, 
-91, 158, 180, 94, 117, 164, 114, 113, 136, 147, 141, 86, 127, 144, 85, 106, 
-158, 107, 118, 177, 127, 96, 162, 155, 65, 140, 191, 97, 142, 221, 119, 119, 
-194, 123, 94, 158, 134, 104, 131, 142, 156, 97, 101, 155, 101, 80, 153, 128, 
-90, 167, 153, 87, 131, 177, 83, 93, 196, 125, 102, 214, 156, 94, 180, 152, 
-84, 138, 149, 101, 123, 137, 154, 115, 85, 145, 122, 73, 131, 146, 87, 146, 
-167, 97, 112, 175, 107, 73, 183, 151, 87, 194, 186, 90, 163, 168, 88, 119, 
-158, 107, 112, 133, 148, 131, 79, 133, 135, 74, 114, 157, 91, 128, 176, 105, 
-98, 176, 124, 62, 173, 167, 84, 176, 203, 92, 149, 185, 94, 113, 164, 114, 
-112, 136, 151, 141, 83, 129, 146, 83, 108, 161, 104, 120, 178, 123, 94, 166, 
-147, 63, 152, 186, 93, 156, 221, 112, 129, 196, 114, 97, 166, 130, 102, 134, 
-147, 152, 88, 112, 157, 90, 88, 160, 116, 99, 176, 138, 85, 151, 164, 66, 
-124, 196, 103, 126, 224, 127, 109, 192, 129, 88, 154, 139, 98, 130, 139, 154, 
-99, 94, 153, 106, 75, 149, 131, 88, 166, 153, 86, 130, 175, 81, 95, 194, 
-125, 102, 212, 159, 93, 182, 151, 84, 137, 154, 100, 119, 138, 153, 120, 82, 
-144, 126, 70, 131, 150, 86, 142, 173, 97, 106, 180, 109, 69, 183, 155, 83, 
-193, 188, 89, 163, 173, 88, 122, 163, 105, 115, 132, 152, 130, 78, 136, 137, 
-74, 115, 158, 92, 130, 177, 107, 99, 176, 128, 63, 168, 173, 85, 171, 208, 
-96, 143, 188, 101, 106, 164, 122, 108, 134, 149, 144, 87, 123, 149, 88, 102, 
-160, 111, 113, 178, 132, 91, 159, 160, 64, 139, 195, 99, 140, 225, 123, 117, 
-198, 123, 95, 162, 135, 102, 134, 143, 153, 96, 103, 155, 102, 81, 154, 128, 
-91, 171, 149, 86, 138, 175, 72, 103, 201, 114, 111, 221, 144, 95, 188, 144, 
-83, 146, 150, 96, 125, 140, 152, 108, 90, 149, 115, 73, 139, 141, 84, 156, 
-163, 89, 119, 179, 92, 80, 189, 140, 89, 201, 180, 87, 168, 167, 86, 124, 
-161, 104, 114, 136, 150, 130, 80, 136, 137, 75, 116, 159, 92, 127, 178, 110, 
-95, 172, 131, 60, 166, 173, 84, 168, 209, 98, 141, 189, 101, 107, 164, 118, 
-107, 136, 148, 144, 90, 122, 149, 89, 101, 159, 109, 113, 178, 128, 91, 161, 
-154, 63, 139, 191, 96, 140, 220, 120, 118, 194, 126, 93, 157, 138, 103, 130, 
-142, 151, 99, 104, 153, 102, 85, 152, 125, 95, 171, 148, 85, 141, 176, 72, 
-104, 200, 112, 109, 223, 147, 95, 190, 144, 83, 149, 150, 97, 127, 139, 153, 
-113, 90, 152, 117, 76, 139, 140, 86, 155, 161, 91, 117, 178, 96, 78, 190, 
-139, 91, 203, 180, 88, 172, 168, 86, 127, 161, 103, 116, 137, 148, 129, 82, 
-135, 132, 76, 117, 155, 91, 129, 173, 104, 95, 171, 124, 58, 168, 167, 79, 
-177, 201, 89, 148, 182, 95, 109, 165, 110, 107, 133, 147, 139, 83, 123, 146, 
-84, 101, 159, 104, 115, 178, 126, 89, 162, 155, 63, 136, 196, 97, 137, 225, 
-123, 115, 193, 128, 90, 158, 140, 101, 133, 143, 151, 102, 103, 151, 107, 86, 
-149, 130, 100, 168, 151, 91, 138, 176, 81, 106, 198, 123, 108, 220, 160, 96, 
-188, 154, 85, 142, 156, 102, 125, 140, 154, 117, 87, 147, 126, 75, 134, 149, 
-88, 151, 171, 97, 112, 181, 106, 69, 185, 154, 82, 186, 196, 88, 154, 180, 
-89, 112, 164, 109, 107, 137, 147, 137, 84, 124, 142, 82, 103, 157, 101, 113, 
-176, 120, 90, 159, 146, 60, 143, 187, 89, 145, 219, 114, 116, 193, 118, 92, 
-158, 135, 96, };
+128, 127, 128, 129, 127, 128, 131, 128, 125, 131, 130, 122, 131, 135, 124, 132, 
+141, 126, 128, 139, 126, 122, 135, 128, 123, 129, 132, 134, 118, 124, 135, 118, 
+117, 137, 125, 119, 143, 131, 114, 136, 140, 106, 127, 153, 119, 127, 165, 128, 
+120, 154, 128, 111, 139, 133, 114, 129, 133, 140, 114, 111, 141, 117, 100, 139, 
+130, 106, 149, 142, 104, 129, 156, 100, 108, 168, 126, 112, 181, 148, 105, 164, 
+143, 98, 134, 146, 108, 122, 135, 146, 122, 94, 140, 126, 83, 130, 145, 95, 
+139, 164, 103, 110, 171, 112, 78, 175, 151, 89, 185, 182, 93, 160, 169, 91, 
+122, 161, 106, 116, 132, 151, 130, 78, 136, 137, 74, 115, 158, 92, 130, 177, 
+107, 99, 176, 128, 63, 168, 173, 85, 171, 208, 96, 143, 188, 101, 106, 164, 
+122, 108, 134, 149, 144, 87, 123, 149, 88, 102, 160, 111, 113, 178, 132, 91, 
+159, 160, 64, 139, 195, 99, 140, 225, 123, 117, 198, 123, 95, 162, 135, 102, 
+134, 143, 153, 96, 103, 155, 102, 81, 154, 128, 91, 171, 149, 86, 138, 175, 
+72, 103, 201, 114, 111, 221, 144, 95, 188, 144, 83, 146, 150, 96, 125, 140, 
+152, 108, 90, 149, 115, 73, 139, 141, 84, 156, 163, 89, 119, 179, 92, 80, 
+189, 140, 89, 201, 180, 87, 168, 167, 86, 124, 161, 104, 114, 136, 150, 130, 
+80, 136, 137, 75, 116, 158, 93, 127, 176, 111, 97, 169, 131, 66, 162, 168, 
+89, 163, 199, 102, 139, 180, 105, 110, 158, 120, 111, 134, 144, 141, 98, 123, 
+144, 98, 108, 151, 114, 117, 164, 128, 102, 151, 146, 83, 136, 171, 107, 136, 
+188, 123, 122, 170, 127, 106, 146, 134, 113, 129, 136, 141, 111, 114, 142, 113, 
+104, 141, 126, 110, 151, 138, 106, 135, 152, 100, 116, 163, 120, 119, 173, 137, 
+113, 156, 135, 108, 137, 137, 115, 128, 133, 138, 122, 113, 137, 124, 108, 132, 
+132, 113, 138, 140, 115, 124, 145, 117, 111, 148, 132, 116, 152, 144, 116, 141, 
+140, 116, 128, 137, 121, 125, 130, 133, 128, 116, 130, 129, 115, 125, 134, 119, 
+128, 138, 123, 121, 137, 127, 114, 136, 136, 118, 137, 142, 121, 132, 138, 122, 
+125, 134, 125, 125, 129, 131, 130, 121, 127, 131, 122, 124, 132, 125, 126, 134, 
+128, 123, 132, 131, 121, 129, 135, 125, 129, 137, 128, 127, 134, 128, 125, 130, 
+129, 126, 128, 129, 130, 126, 126, 129, 127, 126, 129, 128, 127, 130, 129, 126, 
+128, 130, 126, 127, 131, 128, 127, 131, 129, 127, 130, 129, 127, 128, 129, 127, 
+128, 128, 129, 128, 127, 128, 128, 127, 128, 128, 128, 128, 128, 128, 128, 128, 
+128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 
+128, 128, 128, 128, };
 #endif
@@ -0,0 +1,435 @@
+/*
+ *  Lockstep runner between the native build and the AVR firmware.
+ *
+ *  The firmware ELF is run on an emulated ATtiny85 (simavr) while the same
+ *  firmware modules, compiled natively like in the simulator, are run by the
+ *  main loop body shared with main.c (control_loop.h).  Both are fed with
+ *  the same input trace (throttle and buttons ADC levels) and every audio
+ *  sample written to OCR1B, and the status frames sent to the slave ECU
+ *  (ecu_bus.h), are compared.  The first divergence is reported together
+ *  with the native model state.  The free RAM measured by the firmware
+ *  (ram_monitor.h) is reported too.
+ *
+ *  lockstep FIRMWARE.elf [--trace FILE] [--seconds S] [--seed N]
+ *
+ *  The trace file has one "ticks throttle_adc buttons_adc" line per step
+ *  (levels are the 8-bit ADC readings, each step is held for the given
+ *  number of 40 ms ticks, '#' starts a comment).  Without a trace a
+ *  pseudo random one is generated, including throttle levels below idle.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "sim_avr.h"
+#include "sim_elf.h"
+#include "sim_io.h"
+#include "avr_adc.h"
+
+#include "button_manager.h"
+#include "control_loop.h"
+#include "ecu_bus.h"
+#include "sound_manager.h"
+#include "tractor_model.h"
+}
+
+static const unsigned MODEL_CYCLE       = CONTROL_MODEL_CYCLE;
+
+// Inputs of a tick are applied in the middle of it, far from the ADC reads
+static const unsigned INPUT_PHASE       = MODEL_CYCLE / 2;
+
+static const uint32_t VCC_MV            = 5000;
+static const uint32_t F_CPU_HZ          = 8000000;
+
+// ATtiny85 registers (data space addresses)
+static const avr_io_addr_t USIDR_ADDR   = 0x2F;
+static const avr_io_addr_t OCR1B_ADDR   = 0x4B;
+static const avr_io_addr_t GPIOR1_ADDR  = 0x32;
+static const avr_io_addr_t GPIOR2_ADDR  = 0x33;
+
+// ADC channels (pin 7: buttons on ADC1, pin 2: throttle on ADC3)
+static const int ADC_CHANNEL_BUTTONS    = ADC_IRQ_ADC1;
+static const int ADC_CHANNEL_THROTTLE   = ADC_IRQ_ADC3;
+
+static const uint8_t BUTTON_LEVELS[]    = {0, 56, 70, 128, 245};
+
+struct Input {
+    uint8_t throttle;
+    uint8_t buttons;
+};
+
+/**
+ *  Status frames received on the slave ECU bus.  Diagnostic frames are
+ *  skipped: the free RAM is only measured on the AVR.
+ */
+class EcuReceiver
+{
+public:
+    void receive(uint8_t byte)
+    {
+        ++m_bytes;
+        EcuFrame frame;
+        if (ecu_bus_decode(&m_decoder, byte, &frame) && frame.kind != ECU_FRAME_DIAGNOSTIC)
+            m_frames.push_back(frame);
+    }
+
+    unsigned long bytes() const { return m_bytes; }
+    unsigned errors() const { return m_decoder.errors; }
+    const std::vector<EcuFrame> &frames() const { return m_frames; }
+
+private:
+    EcuDecoder              m_decoder = {};
+    std::vector<EcuFrame>   m_frames;
+    unsigned long           m_bytes = 0;
+};
+
+/**
+ *  Input of every tick.  The ADC conversion started at the end of tick k
+ *  reads the input of tick k - 1, and its result is used at tick k + 1.
+ */
+class Trace
+{
+public:
+    bool load(const char *fileName)
+    {
+        std::FILE *file = std::fopen(fileName, "r");
+        if (!file)
+            return false;
+
+        char line[256];
+        while (std::fgets(line, sizeof(line), file)) {
+            if (char *comment = std::strchr(line, '#'))
+                *comment = '\0';
+            unsigned ticks, throttle, buttons;
+            if (std::sscanf(line, "%u %u %u", &ticks, &throttle, &buttons) == 3)
+                append(ticks, {static_cast<uint8_t>(throttle), static_cast<uint8_t>(buttons)});
+        }
+        std::fclose(file);
+        return !m_inputs.empty();
+    }
+
+    void generate(unsigned ticks, uint32_t seed)
+    {
+        // start the engine, then random steps (throttle may be below idle)
+        append(25, {0, 0});
+        append(125, {ADC_THROTTLE_IDLE, 128});
+        while (m_inputs.size() < ticks) {
+            seed = seed * 1664525u + 1013904223u;
+            Input input;
+            input.throttle  = static_cast<uint8_t>(seed >> 24);
+            input.buttons   = BUTTON_LEVELS[(seed >> 8) % sizeof(BUTTON_LEVELS)];
+            if (input.buttons == 0 || input.buttons == 128)
+                input.buttons = 56;     // keep the engine running most of the time
+            append(1 + (seed >> 12) % 50, input);
+        }
+        m_inputs.resize(ticks);
+    }
+
+    size_t ticks() const { return m_inputs.size(); }
+
+    // Input in effect at the given tick (inputs are zero before the trace)
+    Input at(long tick) const
+    {
+        if (tick < 0 || m_inputs.empty())
+            return {0, 0};
+        return m_inputs[std::min<size_t>(static_cast<size_t>(tick), m_inputs.size() - 1)];
+    }
+
+private:
+    std::vector<Input> m_inputs;
+
+    void append(unsigned ticks, Input input)
+    {
+        m_inputs.insert(m_inputs.end(), ticks, input);
+    }
+};
+
+/**
+ *  Native build of the firmware: the main loop body of main.c, fed with the
+ *  ADC values the firmware would read.
+ */
+class NativeFirmware
+{
+public:
+    NativeFirmware()
+    {
+        button_reset();
+        tractor_reset();
+        audio_reset();
+        ecu_bus_reset();
+        control_reset();
+    }
+
+    // Generate the next sample, running the model tick when it is due
+    uint8_t step(const Trace &trace)
+    {
+        uint8_t sample = control_get_next_sample();
+
+        if (control_is_model_update_due()) {
+            control_update_model(m_adcThrottle, m_adcButtons);
+            ++m_tick;
+
+            uint8_t byte;
+            while (ecu_bus_loopback_read(&byte))
+                m_ecu.receive(byte);
+
+            // the conversion started now reads the input of the previous tick
+            Input input = trace.at(static_cast<long>(m_tick) - 1);
+            m_adcThrottle   = input.throttle;
+            m_adcButtons    = input.buttons;
+        }
+        return sample;
+    }
+
+    const EcuReceiver &ecu() const { return m_ecu; }
+
+    void printState() const
+    {
+        std::printf("  native state: tick %lu, engine speed %u, engine status %u, "
+                "horn note %u, adc throttle %u, adc buttons %u\n",
+                m_tick, tractor_get_engine_speed(), tractor_get_engine_status(),
+                audio_get_horn_note(), m_adcThrottle, m_adcButtons);
+    }
+
+private:
+    EcuReceiver     m_ecu;
+    unsigned long   m_tick = 0;
+    uint8_t         m_adcThrottle = 0;
+    uint8_t         m_adcButtons = 0;
+};
+
+/**
+ *  The firmware running on simavr.  Every write to OCR1B is an audio sample,
+ *  and the bytes sent to the slave ECU are rebuilt from the halves written
+ *  to USIDR by the USI overflow interrupt (see ecu_bus.c).
+ */
+class EmulatedFirmware
+{
+public:
+    bool load(const char *fileName)
+    {
+        elf_firmware_t firmware;
+        std::memset(&firmware, 0, sizeof(firmware));
+        if (elf_read_firmware(fileName, &firmware) != 0)
+            return false;
+
+        m_avr = avr_make_mcu_by_name("attiny85");
+        if (!m_avr)
+            return false;
+        avr_init(m_avr);
+        m_avr->frequency    = firmware.frequency ? firmware.frequency : F_CPU_HZ;
+        m_avr->vcc          = VCC_MV;
+        m_avr->avcc         = VCC_MV;
+        m_avr->aref         = VCC_MV;
+        avr_load_firmware(m_avr, &firmware);
+
+        avr_register_io_write(m_avr, OCR1B_ADDR, &EmulatedFirmware::ocr1bWritten, this);
+        avr_register_io_write(m_avr, USIDR_ADDR, &EmulatedFirmware::usidrWritten, this);
+        m_adcThrottle   = avr_io_getirq(m_avr, AVR_IOCTL_ADC_GETIRQ, ADC_CHANNEL_THROTTLE);
+        m_adcButtons    = avr_io_getirq(m_avr, AVR_IOCTL_ADC_GETIRQ, ADC_CHANNEL_BUTTONS);
+        return m_adcThrottle && m_adcButtons;
+    }
+
+    ~EmulatedFirmware()
+    {
+        if (m_avr)
+            avr_terminate(m_avr);
+    }
+
+    // Run until the next audio sample, return false if the CPU stopped
+    bool step(uint8_t &sample)
+    {
+        const auto samples = m_samples;
+        while (m_samples == samples) {
+            int state = avr_run(m_avr);
+            if (state == cpu_Done || state == cpu_Crashed)
+                return false;
+        }
+        sample = m_sample;
+        return true;
+    }
+
+    void setInput(Input input)
+    {
+        avr_raise_irq(m_adcThrottle, millivolts(input.throttle));
+        avr_raise_irq(m_adcButtons, millivolts(input.buttons));
+    }
+
+    const EcuReceiver &ecu() const { return m_ecu; }
+
+    // Free RAM published by the firmware, 0 before the first measurement
+    unsigned freeRam() const
+    {
+        return m_avr->data[GPIOR1_ADDR] | (m_avr->data[GPIOR2_ADDR] << 8);
+    }
+
+private:
+    avr_t           *m_avr = nullptr;
+    avr_irq_t       *m_adcThrottle = nullptr;
+    avr_irq_t       *m_adcButtons = nullptr;
+    EcuReceiver     m_ecu;
+    unsigned long   m_samples = 0;
+    uint8_t         m_sample = 0;
+    int             m_firstHalf = -1;   // -1 while waiting for a first half
+
+    static void ocr1bWritten(avr_t *avr, avr_io_addr_t addr, uint8_t value, void *param)
+    {
+        auto self = static_cast<EmulatedFirmware *>(param);
+        avr->data[addr] = value;
+        self->m_sample = value;
+        ++self->m_samples;
+    }
+
+    /*
+     * First half: start bit and bits 0-6 (MSB clear), second half: bit 7 as
+     * MSB followed by ones.  Idle loads (0xFF) are skipped.
+     */
+    static void usidrWritten(avr_t *avr, avr_io_addr_t addr, uint8_t value, void *param)
+    {
+        auto self = static_cast<EmulatedFirmware *>(param);
+        avr->data[addr] = value;
+        if (self->m_firstHalf < 0) {
+            if (!(value & 0x80))
+                self->m_firstHalf = value;
+            return;
+        }
+
+        uint8_t reversed = static_cast<uint8_t>(self->m_firstHalf << 1) | (value >> 7);
+        uint8_t byte = 0;
+        for (unsigned bit = 0; bit < 8; ++bit)
+            byte |= ((reversed >> bit) & 1) << (7 - bit);
+        self->m_ecu.receive(byte);
+        self->m_firstHalf = -1;
+    }
+
+    /*
+     * Voltage in the middle of the 10-bit code 4 * level + 2, so that the
+     * 8 bits read from ADCH (left adjusted) are exactly the given level.
+     */
+    static uint32_t millivolts(uint8_t level)
+    {
+        return ((level * 4u + 2u) * VCC_MV + 1022u) / 1023u;
+    }
+};
+
+static bool sameStatus(const EcuFrame &a, const EcuFrame &b)
+{
+    return a.kind == b.kind && a.lights == b.lights && a.engine_speed == b.engine_speed;
+}
+
+static void usage(const char *program)
+{
+    std::printf("usage: %s FIRMWARE.elf [--trace FILE] [--seconds S] [--seed N]\n", program);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    const char *traceFile = nullptr;
+    unsigned seconds = 60;
+    uint32_t seed = 1;
+    for (int i = 2; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--trace") && i + 1 < argc)
+            traceFile = argv[++i];
+        else if (!std::strcmp(argv[i], "--seconds") && i + 1 < argc)
+            seconds = std::max(1, std::atoi(argv[++i]));
+        else if (!std::strcmp(argv[i], "--seed") && i + 1 < argc)
+            seed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 0));
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    Trace trace;
+    if (traceFile) {
+        if (!trace.load(traceFile)) {
+            std::fprintf(stderr, "cannot read trace %s\n", traceFile);
+            return 2;
+        }
+    } else {
+        trace.generate(seconds * 25, seed);
+    }
+
+    EmulatedFirmware emulated;
+    if (!emulated.load(argv[1])) {
+        std::fprintf(stderr, "cannot load %s on the emulated attiny85\n", argv[1]);
+        return 2;
+    }
+    NativeFirmware native;
+
+    const unsigned long total = trace.ticks() * MODEL_CYCLE;
+    uint8_t history[2][8] = {{0}};
+
+    for (unsigned long i = 0; i < total; ++i) {
+        if (i % MODEL_CYCLE == INPUT_PHASE)
+            emulated.setInput(trace.at(static_cast<long>(i / MODEL_CYCLE)));
+
+        uint8_t expected = native.step(trace);
+        uint8_t actual;
+        if (!emulated.step(actual)) {
+            std::printf("emulated firmware stopped at sample %lu\n", i);
+            return 1;
+        }
+        history[0][i % 8] = expected;
+        history[1][i % 8] = actual;
+
+        // the emulated frames lag behind by their transmission time
+        const auto &nativeFrames = native.ecu().frames();
+        const auto &emulatedFrames = emulated.ecu().frames();
+        size_t frame = emulatedFrames.size() - 1;
+        bool ecuMismatch = !emulatedFrames.empty() && (frame >= nativeFrames.size() ||
+                !sameStatus(nativeFrames[frame], emulatedFrames[frame]));
+
+        if (expected != actual || ecuMismatch) {
+            std::printf("divergence at sample %lu (tick %lu, sample %lu of the tick): ",
+                    i, i / MODEL_CYCLE, i % MODEL_CYCLE);
+            if (expected != actual) {
+                std::printf("audio native %u, emulated %u\n", expected, actual);
+            } else {
+                const EcuFrame &actualFrame = emulatedFrames[frame];
+                std::printf("ECU status frame %zu emulated (status %u, speed %u, lights %u)",
+                        frame, actualFrame.kind, actualFrame.engine_speed, actualFrame.lights);
+                if (frame < nativeFrames.size()) {
+                    const EcuFrame &expectedFrame = nativeFrames[frame];
+                    std::printf(", native (status %u, speed %u, lights %u)\n",
+                            expectedFrame.kind, expectedFrame.engine_speed, expectedFrame.lights);
+                } else {
+                    std::printf(", not sent by native\n");
+                }
+            }
+
+            for (unsigned side = 0; side < 2; ++side) {
+                std::printf("  %-8s", side ? "emulated" : "native");
+                for (unsigned long j = (i >= 7 ? i - 7 : 0); j <= i; ++j)
+                    std::printf(" %3u", history[side][j % 8]);
+                std::printf("\n");
+            }
+            native.printState();
+            Input input = trace.at(static_cast<long>(i / MODEL_CYCLE));
+            std::printf("  trace input: throttle %u, buttons %u\n", input.throttle, input.buttons);
+            std::printf("  emulated free RAM: %u bytes\n", emulated.freeRam());
+            return 1;
+        }
+    }
+
+    std::printf("%lu samples (%zu ticks) identical\n", total, trace.ticks());
+    if (emulated.ecu().bytes() == 0) {
+        std::printf("warning: no byte sent to the slave ECU by the emulated firmware "
+                "(USI not emulated?), ECU frames not compared\n");
+    } else {
+        std::printf("%zu ECU status frames identical (%u bad checksums)\n",
+                emulated.ecu().frames().size(), emulated.ecu().errors());
+    }
+    std::printf("emulated free RAM: %u bytes\n", emulated.freeRam());
+    return 0;
+}
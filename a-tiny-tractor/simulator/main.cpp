@@ -1,15 +1,53 @@
-#include <QApplication>
-
-#include "simulator.h"
-#include <QStyleFactory>
-
-int main(int argc, char *argv[])
-{
-    QApplication app{argc, argv};
-    QApplication::setStyle(QStyleFactory::create("fusion"));
-
-    Simulator simulator;
-    simulator.show();
-
-    return app.exec();
-}
+#include <QApplication>
+
+#include "simulator.h"
+#include <QStyleFactory>
+
+#include "telemetry_log.h"
+
+extern "C" {
+#include "../attiny/trace.h"
+}
+
+int main(int argc, char *argv[])
+{
+    QApplication app{argc, argv};
+    QApplication::setStyle(QStyleFactory::create("fusion"));
+
+    // simulator --trace trace.json: export a Chrome trace of the session
+    QString traceFile;
+    auto arguments{app.arguments()};
+    auto traceIndex{arguments.indexOf("--trace")};
+    if (traceIndex >= 0 && traceIndex + 1 < arguments.size()) {
+        traceFile = arguments.at(traceIndex + 1);
+        trace_enable(true);
+    }
+
+    // simulator --log session.tlog: record a telemetry log of the session
+    telemetry::Writer telemetryLog;
+    auto logIndex{arguments.indexOf("--log")};
+    if (logIndex >= 0 && logIndex + 1 < arguments.size()) {
+        auto logFile{arguments.at(logIndex + 1)};
+        if (!telemetryLog.open(logFile.toLocal8Bit().constData(), false))
+            qWarning("Cannot create telemetry log %s", qPrintable(logFile));
+    }
+
+    Simulator simulator;
+    if (telemetryLog.ok())
+        simulator.setTelemetryLog(&telemetryLog);
+    simulator.show();
+
+    auto result{app.exec()};
+
+    if (!traceFile.isEmpty()) {
+        trace_enable(false);
+        if (!trace_write_json(traceFile.toLocal8Bit().constData()))
+            qWarning("Cannot write trace file %s", qPrintable(traceFile));
+    }
+
+    if (telemetryLog.ok() && telemetryLog.dropped())
+        qWarning("%llu telemetry rows dropped",
+                static_cast<unsigned long long>(telemetryLog.dropped()));
+
+    return result;
+}
@@ -1,224 +1,290 @@
-#include "simulator.h"
-#include "ui_simulator.h"
-
-#include <QAudioDeviceInfo>
-#include <QMessageBox>
-
-extern "C" {
-#include "../attiny/button_manager.h"
-#include "../attiny/sound_manager.h"
-#include "../attiny/tractor_model.h"
-}
-
-static auto DATA_SAMPLE_RATE_HZ = 8000;
-static auto BUFFER_SIZE         = 4000;
-
-static uint8_t ADC_LEVEL_OFF            = 0;
-static uint8_t ADC_LEVEL_ON             = 56;
-static uint8_t ADC_LEVEL_ON_HORN        = 70;
-static uint8_t ADC_LEVEL_ON_START       = 128;
-static uint8_t ADC_LEVEL_ON_START_HORN  = 245;
-
-static uint8_t PWM_MIN  = 6;
-static uint8_t PWM_MAX  = 58;
-
-
-AudioGenerator::AudioGenerator(QObject *parent) : QIODevice{parent}
-{
-}
-
-void AudioGenerator::start()
-{
-    open(QIODevice::ReadOnly);
-}
-
-void AudioGenerator::stop()
-{
-    close();
-}
-
-qint64 AudioGenerator::readData(char *data, qint64 maxSize)
-{
-    // override maxSize to avoid high latency in the reaction!
-    maxSize = DATA_SAMPLE_RATE_HZ / 25;
-
-    for (auto i = 0; i < maxSize; i++)
-        data[i] = static_cast<char>(
-                audio_get_next_sample(tractor_get_engine_speed()));
-
-    return maxSize;
-}
-
-qint64 AudioGenerator::writeData(const char *data, qint64 maxSize)
-{
-    Q_UNUSED(data);
-    Q_UNUSED(maxSize);
-
-    return 0;
-}
-
-qint64 AudioGenerator::bytesAvailable() const
-{
-    return QIODevice::bytesAvailable();
-}
-
-
-
-Simulator::Simulator(QWidget *parent) : QWidget{parent},
-    m_ui{new Ui::Simulator{}},
-    m_audioOutput{0},
-    m_audioGenerator{0},
-    m_pushTimer{new QTimer{this}},
-    m_buffer{new char[BUFFER_SIZE]},
-    m_ledStatus{false}
-{
-    m_ui->setupUi(this);
-    m_ui->progressBar_engineSpeed->setMaximum(ENGINE_SPEED_MAX);
-
-    openAudioDevice();
-
-    connect(m_pushTimer, &QTimer::timeout,
-            this, &Simulator::pushTimerExpired);
-
-    connect(m_ui->pushButton_ignition, &QPushButton::toggled,
-            [=](bool checked) {
-                button_set_adc_value(checked ?
-                        ADC_LEVEL_ON : ADC_LEVEL_OFF);
-                setGuiStatus(checked);
-            });
-
-    connect(m_ui->pushButton_ignition_start, &QPushButton::pressed,
-            [=]() {
-                button_set_adc_value(m_ui->pushButton_horn->isDown() ?
-                        ADC_LEVEL_ON_START_HORN : ADC_LEVEL_ON_START);
-            });
-
-    connect(m_ui->pushButton_ignition_start, &QPushButton::released,
-            [=]() {
-                button_set_adc_value(m_ui->pushButton_horn->isDown() ?
-                        ADC_LEVEL_ON_HORN : ADC_LEVEL_ON);
-            });
-
-    connect(m_ui->pushButton_horn, &QPushButton::pressed,
-            [=]() {
-                button_set_adc_value(m_ui->pushButton_ignition_start->isDown() ?
-                        ADC_LEVEL_ON_START_HORN : ADC_LEVEL_ON_HORN);
-            });
-
-    connect(m_ui->pushButton_horn, &QPushButton::released,
-            [=]() {
-                button_set_adc_value(m_ui->pushButton_ignition_start->isDown() ?
-                        ADC_LEVEL_ON_START : ADC_LEVEL_ON);
-            });
-}
-
-Simulator::~Simulator()
-{
-    closeAudioDevice();
-    delete[] m_buffer;
-}
-
-void Simulator::pushTimerExpired()
-{
-    // manage button levels
-    if (button_is_clicked(BUTTON_HORN))
-        tractor_play_dixie_song();
-
-    if (button_is_pressed(BUTTON_START))
-        tractor_set_ignition_position(IGNITION_START);
-    else if (button_is_pressed(BUTTON_ON))
-        tractor_set_ignition_position(IGNITION_ON);
-    else
-        tractor_set_ignition_position(IGNITION_OFF);
-
-    // manage tractor model
-    bool ledStatus = tractor_update_model();
-    setLedStatus(ledStatus);
-
-    auto setpoint{m_ui->horizontalSlider_throttle->value()};
-    uint8_t engineSpeed{tractor_get_engine_speed()};
-
-    tractor_set_engine_speed_setpoint(static_cast<uint8_t>(ENGINE_SPEED_IDLE +
-            setpoint * 0.01 * (ENGINE_SPEED_MAX - ENGINE_SPEED_IDLE)));
-    m_ui->progressBar_engineSpeed->setValue(engineSpeed);
-
-    uint8_t dutyCycle;
-    if (engineSpeed < ENGINE_SPEED_MIN) {
-        dutyCycle = 0;
-    } else {
-        dutyCycle = PWM_MIN + ((engineSpeed - ENGINE_SPEED_IDLE) >> 1);
-        if (dutyCycle > PWM_MAX)
-            dutyCycle = PWM_MAX;
-    }
-    m_ui->progressBar_motorPwm->setValue(dutyCycle);
-
-    if (m_audioOutput && m_audioOutput->state() != QAudio::StoppedState) {
-        auto chunks{qMin(1, m_audioOutput->bytesFree() / m_audioOutput->periodSize())};
-
-        while (chunks) {
-            auto chunkSize{m_audioGenerator->read(m_buffer, m_audioOutput->periodSize())};
-            if (chunkSize)
-                m_output->write(m_buffer, chunkSize);
-            --chunks;
-        }
-    }
-}
-
-void Simulator::openAudioDevice()
-{
-    QAudioFormat audioFormat;
-    audioFormat.setSampleRate(DATA_SAMPLE_RATE_HZ);
-    audioFormat.setChannelCount(1);
-    audioFormat.setSampleSize(8);
-    audioFormat.setCodec("audio/pcm");
-    audioFormat.setByteOrder(QAudioFormat::LittleEndian);
-    audioFormat.setSampleType(QAudioFormat::UnSignedInt);
-
-    QAudioDeviceInfo defaultDeviceInfo{QAudioDeviceInfo::defaultOutputDevice()};
-    if (!defaultDeviceInfo.isFormatSupported(audioFormat)) {
-        QMessageBox::critical(this, windowTitle(), "Audio format is not supported");
-        qFatal("Audio format is not supported");
-    }
-
-    if (m_audioGenerator)
-        delete m_audioGenerator;
-    m_audioGenerator = new AudioGenerator{this};
-    m_audioGenerator->start();
-
-    m_audioOutput = new QAudioOutput{defaultDeviceInfo, audioFormat, this};
-    m_output = m_audioOutput->start();
-    m_audioOutput->resume();
-
-    m_pushTimer->start(40);
-}
-
-void Simulator::closeAudioDevice()
-{
-    m_audioOutput->suspend();
-    m_audioGenerator->stop();
-    m_audioOutput->stop();
-}
-
-void Simulator::setGuiStatus(bool status)
-{
-    m_ui->pushButton_ignition->setText(status ? "ON" : "OFF");
-    m_ui->pushButton_ignition_start->setEnabled(status);
-    m_ui->pushButton_horn->setEnabled(status);
-
-    m_ui->frame_io->setEnabled(status);
-    m_ui->horizontalSlider_throttle->setValue(
-            m_ui->horizontalSlider_throttle->minimum());
-}
-
-void Simulator::setLedStatus(bool status)
-{
-    if (status != m_ledStatus) {
-        m_ledStatus = status;
-        m_ui->widget_led->setStyleSheet(
-            QString("QWidget {"
-            "border: 4px solid #aaa;"
-            "border-radius: 20px;"
-            "background-color: %1;"
-            "}").arg(m_ledStatus ? "#fff" : "#ddd"));
-    }
-}
+#include "simulator.h"
+#include "ui_simulator.h"
+
+#include <QAudioDeviceInfo>
+#include <QMessageBox>
+
+#include "telemetry_log.h"
+
+extern "C" {
+#include "../attiny/button_manager.h"
+#include "../attiny/ecu_bus.h"
+#include "../attiny/sound_manager.h"
+#include "../attiny/tractor_model.h"
+#include "../attiny/trace.h"
+}
+
+static auto DATA_SAMPLE_RATE_HZ = 8000;
+static auto BUFFER_SIZE         = 4000;
+
+static uint8_t ADC_LEVEL_OFF            = 0;
+static uint8_t ADC_LEVEL_ON             = 56;
+static uint8_t ADC_LEVEL_ON_HORN        = 70;
+static uint8_t ADC_LEVEL_ON_START       = 128;
+static uint8_t ADC_LEVEL_ON_START_HORN  = 245;
+
+static uint8_t PWM_MIN  = 6;
+static uint8_t PWM_MAX  = 58;
+
+
+AudioGenerator::AudioGenerator(QObject *parent) : QIODevice{parent},
+    m_sampleCount{0}
+{
+}
+
+void AudioGenerator::start()
+{
+    open(QIODevice::ReadOnly);
+}
+
+void AudioGenerator::stop()
+{
+    close();
+}
+
+qint64 AudioGenerator::readData(char *data, qint64 maxSize)
+{
+    TRACE_BEGIN("AudioGenerator::readData");
+
+    // override maxSize to avoid high latency in the reaction!
+    maxSize = DATA_SAMPLE_RATE_HZ / 25;
+
+    for (auto i = 0; i < maxSize; i++)
+        data[i] = static_cast<char>(
+                audio_get_next_sample(tractor_get_engine_speed()));
+    m_sampleCount += maxSize;
+
+    TRACE_END("AudioGenerator::readData");
+    return maxSize;
+}
+
+qint64 AudioGenerator::writeData(const char *data, qint64 maxSize)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+
+    return 0;
+}
+
+qint64 AudioGenerator::bytesAvailable() const
+{
+    return QIODevice::bytesAvailable();
+}
+
+quint16 AudioGenerator::takeSampleCount()
+{
+    auto sampleCount{m_sampleCount};
+    m_sampleCount = 0;
+    return sampleCount;
+}
+
+
+
+Simulator::Simulator(QWidget *parent) : QWidget{parent},
+    m_ui{new Ui::Simulator{}},
+    m_audioOutput{0},
+    m_audioGenerator{0},
+    m_pushTimer{new QTimer{this}},
+    m_buffer{new char[BUFFER_SIZE]},
+    m_ledStatus{false},
+    m_ecuDecoder{},
+    m_ecuFrame{},
+    m_telemetry{nullptr},
+    m_tick{0}
+{
+    m_ui->setupUi(this);
+    m_ui->progressBar_engineSpeed->setMaximum(ENGINE_SPEED_MAX);
+
+    trace_set_thread_name("GUI");
+
+    openAudioDevice();
+
+    connect(m_pushTimer, &QTimer::timeout,
+            this, &Simulator::pushTimerExpired);
+
+    connect(m_ui->pushButton_ignition, &QPushButton::toggled,
+            [=](bool checked) {
+                button_set_adc_value(checked ?
+                        ADC_LEVEL_ON : ADC_LEVEL_OFF);
+                setGuiStatus(checked);
+            });
+
+    connect(m_ui->pushButton_ignition_start, &QPushButton::pressed,
+            [=]() {
+                button_set_adc_value(m_ui->pushButton_horn->isDown() ?
+                        ADC_LEVEL_ON_START_HORN : ADC_LEVEL_ON_START);
+            });
+
+    connect(m_ui->pushButton_ignition_start, &QPushButton::released,
+            [=]() {
+                button_set_adc_value(m_ui->pushButton_horn->isDown() ?
+                        ADC_LEVEL_ON_HORN : ADC_LEVEL_ON);
+            });
+
+    connect(m_ui->pushButton_horn, &QPushButton::pressed,
+            [=]() {
+                button_set_adc_value(m_ui->pushButton_ignition_start->isDown() ?
+                        ADC_LEVEL_ON_START_HORN : ADC_LEVEL_ON_HORN);
+            });
+
+    connect(m_ui->pushButton_horn, &QPushButton::released,
+            [=]() {
+                button_set_adc_value(m_ui->pushButton_ignition_start->isDown() ?
+                        ADC_LEVEL_ON_START : ADC_LEVEL_ON);
+            });
+}
+
+Simulator::~Simulator()
+{
+    closeAudioDevice();
+    delete[] m_buffer;
+}
+
+void Simulator::setTelemetryLog(telemetry::Writer *writer)
+{
+    m_telemetry = writer;
+}
+
+void Simulator::pushTimerExpired()
+{
+    TRACE_BEGIN("Simulator::pushTimerExpired");
+
+    // manage button levels
+    if (button_is_clicked(BUTTON_HORN))
+        tractor_play_dixie_song();
+
+    if (button_is_pressed(BUTTON_START))
+        tractor_set_ignition_position(IGNITION_START);
+    else if (button_is_pressed(BUTTON_ON))
+        tractor_set_ignition_position(IGNITION_ON);
+    else
+        tractor_set_ignition_position(IGNITION_OFF);
+
+    // manage tractor model
+    bool ledStatus = tractor_update_model();
+
+    auto setpoint{m_ui->horizontalSlider_throttle->value()};
+    uint8_t engineSpeed{tractor_get_engine_speed()};
+
+    tractor_set_engine_speed_setpoint(static_cast<uint8_t>(ENGINE_SPEED_IDLE +
+            setpoint * 0.01 * (ENGINE_SPEED_MAX - ENGINE_SPEED_IDLE)));
+    m_ui->progressBar_engineSpeed->setValue(engineSpeed);
+
+    // send outputs to the slave ECU, played by the GUI on the loopback
+    ecu_bus_send_status(tractor_get_engine_status(), engineSpeed,
+            ledStatus ? ECU_LIGHT_BEACON : 0);
+
+    uint8_t byte;
+    EcuFrame frame;
+    while (ecu_bus_loopback_read(&byte)) {
+        if (ecu_bus_decode(&m_ecuDecoder, byte, &frame) &&
+                frame.kind != ECU_FRAME_DIAGNOSTIC)
+            m_ecuFrame = frame;
+    }
+
+    // same mapping as the slave ECU (see motorDutyCycle in slave_ecu.ino)
+    ledStatus = m_ecuFrame.lights & ECU_LIGHT_BEACON;
+    setLedStatus(ledStatus);
+
+    uint8_t dutyCycle;
+    if (m_ecuFrame.engine_speed < ENGINE_SPEED_MIN) {
+        dutyCycle = 0;
+    } else {
+        dutyCycle = PWM_MIN + ((m_ecuFrame.engine_speed - ENGINE_SPEED_IDLE) >> 1);
+        if (dutyCycle > PWM_MAX)
+            dutyCycle = PWM_MAX;
+    }
+    m_ui->progressBar_motorPwm->setValue(dutyCycle);
+
+    if (m_audioOutput && m_audioOutput->state() != QAudio::StoppedState) {
+        auto chunks{qMin(1, m_audioOutput->bytesFree() / m_audioOutput->periodSize())};
+
+        while (chunks) {
+            auto chunkSize{m_audioGenerator->read(m_buffer, m_audioOutput->periodSize())};
+            if (chunkSize)
+                m_output->write(m_buffer, chunkSize);
+            --chunks;
+        }
+    }
+
+    if (m_telemetry) {
+        // a tick handled more than one period late means missed periods
+        auto overruns{m_tickTimer.isValid() ?
+                qMax<qint64>(0, m_tickTimer.restart() / TRACTOR_STATUS_UPDATE_CYCLE - 1) : 0};
+        if (!m_tickTimer.isValid())
+            m_tickTimer.start();
+
+        telemetry::Record row;
+        row.tick            = m_tick;
+        row.engineSpeed     = engineSpeed;
+        row.engineStatus    = tractor_get_engine_status();
+        row.led             = ledStatus;
+        row.motorDuty       = dutyCycle;
+        row.hornNote        = audio_get_horn_note();
+        row.loopCycles      = m_audioGenerator->takeSampleCount();
+        row.overruns        = static_cast<uint8_t>(qMin<qint64>(overruns, 255));
+        m_telemetry->push(row);
+        m_tick += 1 + overruns;
+    }
+
+    TRACE_END("Simulator::pushTimerExpired");
+}
+
+void Simulator::openAudioDevice()
+{
+    QAudioFormat audioFormat;
+    audioFormat.setSampleRate(DATA_SAMPLE_RATE_HZ);
+    audioFormat.setChannelCount(1);
+    audioFormat.setSampleSize(8);
+    audioFormat.setCodec("audio/pcm");
+    audioFormat.setByteOrder(QAudioFormat::LittleEndian);
+    audioFormat.setSampleType(QAudioFormat::UnSignedInt);
+
+    QAudioDeviceInfo defaultDeviceInfo{QAudioDeviceInfo::defaultOutputDevice()};
+    if (!defaultDeviceInfo.isFormatSupported(audioFormat)) {
+        QMessageBox::critical(this, windowTitle(), "Audio format is not supported");
+        qFatal("Audio format is not supported");
+    }
+
+    if (m_audioGenerator)
+        delete m_audioGenerator;
+    m_audioGenerator = new AudioGenerator{this};
+    m_audioGenerator->start();
+
+    m_audioOutput = new QAudioOutput{defaultDeviceInfo, audioFormat, this};
+    m_output = m_audioOutput->start();
+    m_audioOutput->resume();
+
+    m_pushTimer->start(40);
+}
+
+void Simulator::closeAudioDevice()
+{
+    m_audioOutput->suspend();
+    m_audioGenerator->stop();
+    m_audioOutput->stop();
+}
+
+void Simulator::setGuiStatus(bool status)
+{
+    m_ui->pushButton_ignition->setText(status ? "ON" : "OFF");
+    m_ui->pushButton_ignition_start->setEnabled(status);
+    m_ui->pushButton_horn->setEnabled(status);
+
+    m_ui->frame_io->setEnabled(status);
+    m_ui->horizontalSlider_throttle->setValue(
+            m_ui->horizontalSlider_throttle->minimum());
+}
+
+void Simulator::setLedStatus(bool status)
+{
+    if (status != m_ledStatus) {
+        m_ledStatus = status;
+        m_ui->widget_led->setStyleSheet(
+            QString("QWidget {"
+            "border: 4px solid #aaa;"
+            "border-radius: 20px;"
+            "background-color: %1;"
+            "}").arg(m_ledStatus ? "#fff" : "#ddd"));
+    }
+}
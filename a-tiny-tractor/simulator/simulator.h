@@ -1,55 +1,76 @@
-#pragma once
-
-#include <QWidget>
-#include <QAudioFormat>
-#include <QAudioOutput>
-#include <QIODevice>
-#include <QTimer>
-
-class AudioGenerator : public QIODevice
-{
-    Q_OBJECT
-
-public:
-    AudioGenerator(QObject *parent);
-
-    void start();
-    void stop();
-
-    qint64 readData(char *data, qint64 maxSize);
-    qint64 writeData(const char *data, qint64 maxSize);
-    qint64 bytesAvailable() const;
-};
-
-
-namespace Ui {
-    class Simulator;
-}
-
-class Simulator : public QWidget
-{
-    Q_OBJECT
-
-public:
-    Simulator(QWidget *parent = 0);
-    ~Simulator();
-
-private slots:
-    void pushTimerExpired();
-
-private:
-    Ui::Simulator       *m_ui;
-    QAudioOutput        *m_audioOutput;
-    QIODevice           *m_output;
-    AudioGenerator      *m_audioGenerator;
-    QTimer              *m_pushTimer;
-    char                *m_buffer;
-    bool                m_ledStatus;
-
-    void openAudioDevice();
-    void closeAudioDevice();
-
-    void setGuiStatus(bool status);
-
-    void setLedStatus(bool status);
-};
+#pragma once
+
+#include <QWidget>
+#include <QAudioFormat>
+#include <QAudioOutput>
+#include <QElapsedTimer>
+#include <QIODevice>
+#include <QTimer>
+
+extern "C" {
+#include "../attiny/ecu_bus.h"
+}
+
+class AudioGenerator : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    AudioGenerator(QObject *parent);
+
+    void start();
+    void stop();
+
+    qint64 readData(char *data, qint64 maxSize);
+    qint64 writeData(const char *data, qint64 maxSize);
+    qint64 bytesAvailable() const;
+
+    quint16 takeSampleCount();
+
+private:
+    quint16 m_sampleCount;
+};
+
+
+namespace Ui {
+    class Simulator;
+}
+
+namespace telemetry {
+    class Writer;
+}
+
+class Simulator : public QWidget
+{
+    Q_OBJECT
+
+public:
+    Simulator(QWidget *parent = 0);
+    ~Simulator();
+
+    void setTelemetryLog(telemetry::Writer *writer);
+
+private slots:
+    void pushTimerExpired();
+
+private:
+    Ui::Simulator       *m_ui;
+    QAudioOutput        *m_audioOutput;
+    QIODevice           *m_output;
+    AudioGenerator      *m_audioGenerator;
+    QTimer              *m_pushTimer;
+    char                *m_buffer;
+    bool                m_ledStatus;
+    EcuDecoder          m_ecuDecoder;
+    EcuFrame            m_ecuFrame;
+    telemetry::Writer   *m_telemetry;
+    QElapsedTimer       m_tickTimer;
+    quint32             m_tick;
+
+    void openAudioDevice();
+    void closeAudioDevice();
+
+    void setGuiStatus(bool status);
+
+    void setLedStatus(bool status);
+};
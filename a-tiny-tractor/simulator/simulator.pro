@@ -8,17 +8,27 @@ CONFIG      +=  c++11
 
 HEADERS     =   simulator.h \
                 ../attiny/button_manager.h \
+                ../attiny/ecu_bus.h \
                 ../attiny/sound_manager.h \
                 ../attiny/tractor_model.h \
+                ../attiny/platform.h \
+                ../attiny/trace.h \
                 ../attiny/engine_running.h \
                 ../attiny/tractor_horn.h \
+                ../telemetry/telemetry_log.h \
 
 SOURCES     =   main.cpp \
                 simulator.cpp \
+                trace_recorder.cpp \
                 ../attiny/sound_manager.c \
                 ../attiny/button_manager.c \
+                ../attiny/ecu_bus.c \
                 ../attiny/tractor_model.c
 
 FORMS       =   simulator.ui
 
-INCLUDEPATH +=  ../attiny
+INCLUDEPATH +=  ../attiny \
+                ../../libraries/TinyInput/src \
+                ../telemetry
+
+DEFINES     +=  TRACE_ENABLED
@@ -0,0 +1,156 @@
+/*
+ *  Host implementation of the tracing hooks declared in trace.h.
+ *
+ *  Every thread records its events in its own ring buffer, which is only ever
+ *  written by that thread: recording an event is a store in the buffer plus
+ *  a release store of the head index, without locks.  Buffers are registered
+ *  in a lock-free list the first time a thread records an event and are never
+ *  released, so the events of terminated threads are exported too.  When a
+ *  buffer is full the oldest events are overwritten.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "../attiny/trace.h"
+}
+
+namespace {
+
+const size_t BUFFER_CAPACITY = 1 << 20;     // events per thread
+
+struct Event {
+    int64_t     timestamp;                  // ns since the trace start
+    const char  *name;
+    int32_t     value;
+    char        phase;                      // 'B', 'E' or 'C'
+};
+
+struct ThreadBuffer {
+    std::vector<Event>      events;
+    std::atomic<uint64_t>   head{0};
+    int                     tid;
+    std::string             name;
+    ThreadBuffer            *next;
+};
+
+std::atomic<bool> s_enabled{false};
+std::atomic<ThreadBuffer *> s_buffers{nullptr};
+std::atomic<int> s_nextTid{1};
+const auto s_start = std::chrono::steady_clock::now();
+
+ThreadBuffer *threadBuffer()
+{
+    static thread_local ThreadBuffer *buffer = nullptr;
+    if (!buffer) {
+        buffer = new ThreadBuffer;
+        buffer->events.resize(BUFFER_CAPACITY);
+        buffer->tid = s_nextTid++;
+        buffer->next = s_buffers.load();
+        while (!s_buffers.compare_exchange_weak(buffer->next, buffer))
+            ;
+    }
+    return buffer;
+}
+
+inline void record(char phase, const char *name, int32_t value)
+{
+    if (!s_enabled.load(std::memory_order_relaxed))
+        return;
+
+    ThreadBuffer *buffer = threadBuffer();
+    uint64_t head = buffer->head.load(std::memory_order_relaxed);
+    Event &event = buffer->events[head & (BUFFER_CAPACITY - 1)];
+    event.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - s_start).count();
+    event.name = name;
+    event.value = value;
+    event.phase = phase;
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+std::string escape(const std::string &text)
+{
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\')
+            escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+}
+
+extern "C" {
+
+void trace_enable(bool enabled)
+{
+    s_enabled = enabled;
+}
+
+void trace_set_thread_name(const char *name)
+{
+    threadBuffer()->name = name;
+}
+
+void trace_begin(const char *name)
+{
+    record('B', name, 0);
+}
+
+void trace_end(const char *name)
+{
+    record('E', name, 0);
+}
+
+void trace_counter(const char *name, int32_t value)
+{
+    record('C', name, value);
+}
+
+bool trace_write_json(const char *filename)
+{
+    FILE *file = std::fopen(filename, "w");
+    if (!file)
+        return false;
+
+    std::fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    const char *separator = "";
+    for (ThreadBuffer *buffer = s_buffers.load(); buffer; buffer = buffer->next) {
+        if (!buffer->name.empty()) {
+            std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                    "\"tid\":%d,\"args\":{\"name\":\"%s\"}}", separator,
+                    buffer->tid, escape(buffer->name).c_str());
+            separator = ",\n";
+        }
+
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        uint64_t first = head > BUFFER_CAPACITY ? head - BUFFER_CAPACITY : 0;
+        int depth = 0;
+        for (uint64_t i = first; i < head; ++i) {
+            const Event &event = buffer->events[i & (BUFFER_CAPACITY - 1)];
+
+            // skip the ends of sections whose beginning was overwritten
+            if (event.phase == 'E' && depth == 0)
+                continue;
+            depth += (event.phase == 'B') - (event.phase == 'E');
+
+            std::fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,"
+                    "\"pid\":1,\"tid\":%d", separator, event.name, event.phase,
+                    event.timestamp / 1000.0, buffer->tid);
+            if (event.phase == 'C')
+                std::fprintf(file, ",\"args\":{\"value\":%d}", event.value);
+            std::fprintf(file, "}");
+            separator = ",\n";
+        }
+    }
+    std::fprintf(file, "\n]}\n");
+    return std::fclose(file) == 0;
+}
+
+}
@@ -0,0 +1,139 @@
+// Reference slave ECU for A Tiny Tractor.
+//
+// Receives the status frames sent by the ATtiny85 on its pin 6 and drives the
+// beacon LED and the DC motor.  The protocol is defined in attiny/ecu_bus.h:
+// the decoder below must be kept in sync with ecu_bus_decode.
+//
+// Wiring (Arduino Leonardo / Micro, the USB serial stays free for debug):
+//  - ATtiny85 pin 6 (PB1) -> RX (pin 0, Serial1)
+//  - ATtiny85 GND         -> GND
+//  - beacon LED           -> pin 13
+//  - DC motor driver      -> pin 9 (PWM)
+
+// #define DEBUG_SLAVE_ECU
+
+static const long ECU_BAUD_RATE {8000};
+
+static const uint8_t LED_PIN {13};
+static const uint8_t DC_MOTOR_PIN {9};
+
+// Outputs are turned off when no valid frame arrives for this long [ms]
+// (status frames are sent every 40 ms)
+static const unsigned long FAILSAFE_TIMEOUT {200};
+
+// ** Protocol (see attiny/ecu_bus.h) ** //
+static const uint8_t ECU_FRAME_SIZE {3};
+static const uint8_t ECU_FRAME_DIAGNOSTIC {7};
+static const uint8_t ECU_LIGHT_BEACON {0x01};
+
+// Engine speed in BP6 (64 = 800 rpm)
+static const uint8_t ENGINE_SPEED_IDLE {64};
+static const uint8_t ENGINE_SPEED_MIN {68};
+
+// Motor duty cycle on 6 bits
+static const uint8_t PWM_DC_MOTOR_MIN {6};
+static const uint8_t PWM_DC_MOTOR_MAX {58};
+
+struct EcuFrame {
+    uint8_t kind;
+    uint8_t lights;
+    uint8_t engineSpeed;
+    uint16_t freeRam;
+};
+
+class EcuDecoder {
+public:
+    // Return true when byte completes a valid frame
+    bool decode(uint8_t byte, EcuFrame &frame) {
+        if (byte & 0x80)
+            m_size = 0;         // start of a frame, always resynchronize
+        else if (m_size == 0)
+            return false;       // waiting for the start of a frame
+
+        m_byte[m_size++] = byte;
+        if (m_size < ECU_FRAME_SIZE)
+            return false;
+
+        m_size = 0;
+        if (((m_byte[0] + m_byte[1]) & 0x7F) != m_byte[2]) {
+            ++m_errors;
+            return false;
+        }
+
+        frame.kind = (m_byte[0] >> 4) & 0x07;
+        if (frame.kind == ECU_FRAME_DIAGNOSTIC) {
+            frame.freeRam = (uint16_t(m_byte[0] & 0x0F) << 7) | m_byte[1];
+        } else {
+            frame.lights = m_byte[0] & 0x0F;
+            frame.engineSpeed = m_byte[1] << 1;
+        }
+        return true;
+    }
+
+    uint16_t errors() const { return m_errors; }
+
+private:
+    uint8_t m_byte[ECU_FRAME_SIZE] {};
+    uint8_t m_size {};
+    uint16_t m_errors {};
+};
+
+// ** Outputs ** //
+// Speed: 68 (850 rpm) -> PWM: 6 (10%)
+// Speed: 168 (2100 rpm) -> PWM: 56 (90%)
+// Relation: PWM = 6 + (speed - 68) * 50 / 100 ~> 6 + (speed - 68) >> 1
+static uint8_t motorDutyCycle(uint8_t engineSpeed) {
+    if (engineSpeed < ENGINE_SPEED_MIN)
+        return 0;
+
+    uint8_t dutyCycle = PWM_DC_MOTOR_MIN + ((engineSpeed - ENGINE_SPEED_IDLE) >> 1);
+    return dutyCycle > PWM_DC_MOTOR_MAX ? PWM_DC_MOTOR_MAX : dutyCycle;
+}
+
+static void setOutputs(uint8_t lights, uint8_t engineSpeed) {
+    digitalWrite(LED_PIN, (lights & ECU_LIGHT_BEACON) ? HIGH : LOW);
+    analogWrite(DC_MOTOR_PIN, motorDutyCycle(engineSpeed) << 2);
+}
+
+// ** Main ** //
+static EcuDecoder decoder;
+static unsigned long lastFrameTime;
+static bool failsafe {true};
+
+void setup() {
+    pinMode(LED_PIN, OUTPUT);
+    pinMode(DC_MOTOR_PIN, OUTPUT);
+    setOutputs(0, 0);
+
+    // 8000 baud is exact with a 16 MHz clock (UBRR = 124)
+    Serial1.begin(ECU_BAUD_RATE);
+#ifdef DEBUG_SLAVE_ECU
+    Serial.begin(115200);
+#endif
+}
+
+void loop() {
+    while (Serial1.available() > 0) {
+        EcuFrame frame;
+        if (!decoder.decode(Serial1.read(), frame))
+            continue;
+
+        lastFrameTime = millis();
+        failsafe = false;
+        if (frame.kind == ECU_FRAME_DIAGNOSTIC) {
+#ifdef DEBUG_SLAVE_ECU
+            Serial.print(F("free RAM: "));
+            Serial.print(frame.freeRam);
+            Serial.print(F(" B, bad frames: "));
+            Serial.println(decoder.errors());
+#endif
+        } else {
+            setOutputs(frame.lights, frame.engineSpeed);
+        }
+    }
+
+    if (!failsafe && millis() - lastFrameTime > FAILSAFE_TIMEOUT) {
+        failsafe = true;
+        setOutputs(0, 0);
+    }
+}
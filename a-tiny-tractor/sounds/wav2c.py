@@ -1,14 +1,41 @@
 # !/usr/bin/env python
 # -*- coding: utf-8 -*-
 import os.path
+import struct
 import sys
 import wave
 
 
+def read_loop(wav_filename, length):
+    """Return the (start, end) sample range of the first loop in the 'smpl'
+    chunk of the wav file (end excluded), or the whole track if there is no
+    loop."""
+    with open(wav_filename, 'rb') as wav_file:
+        riff = wav_file.read(12)
+        while True:
+            header = wav_file.read(8)
+            if len(header) < 8:
+                return 0, length
+            chunk_id, chunk_size = struct.unpack('<4sI', header)
+            data = wav_file.read(chunk_size + (chunk_size & 1))
+            if chunk_id != b'smpl' or chunk_size < 36:
+                continue
+            loop_count = struct.unpack_from('<I', data, 28)[0]
+            if loop_count == 0 or chunk_size < 36 + 24:
+                return 0, length
+            # the end of a smpl loop is the last sample played in the loop
+            start, end = struct.unpack_from('<II', data, 36 + 8)
+            if start > end or end >= length:
+                print("Error: wav loop exceeds the track!")
+                sys.exit(1)
+            return start, end + 1
+
+
 def wav_to_c(wav_filename, code_filename, array_name):
     with wave.open(wav_filename, 'r') as wav_file, \
             open(code_filename, 'w') as code_file:
         length = wav_file.getnframes()
+        loop_start, loop_end = read_loop(wav_filename, length)
 
         if wav_file.getnchannels() != 1:
             print("Error: wav file must be a MONO track!")
@@ -33,13 +60,18 @@ def wav_to_c(wav_filename, code_filename, array_name):
 #define PROGMEM
 #endif
 
+/* [0, LOOP_START) attack, [LOOP_START, LOOP_END) sustain loop, then release */
 #define {2}_SIZE {3}
+#define {2}_LOOP_START {4}
+#define {2}_LOOP_END {5}
 static const uint8_t {2}[{2}_SIZE] PROGMEM = {{
 """.format(
             wav_filename,
             code_filename,
             array_name,
-            length))
+            length,
+            loop_start,
+            loop_end))
 
         row_count = 0
         for i in range(0, length):
@@ -56,7 +88,11 @@ static const uint8_t {2}[{2}_SIZE] PROGMEM = {{
 
 if __name__ == "__main__":
     USAGE = """wav2c.py - Convert a 8KHz, 8bit, mono file to a C header file
-    usage: python3 wav2c.py sound_file.wav code_file.h var_name"""
+    usage: python3 wav2c.py sound_file.wav code_file.h var_name
+
+    The first loop of the 'smpl' chunk, if any, is exported as the sustain
+    loop of the track (var_name_LOOP_START and var_name_LOOP_END), otherwise
+    the whole track is looped."""
 
     if len(sys.argv) != 4:
         print(USAGE)
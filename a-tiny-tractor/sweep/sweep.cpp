@@ -0,0 +1,251 @@
+/*
+ *  Parameter sweep renderer for sound QA.
+ *
+ *  Every combination of ignition sequence, throttle setpoint and horn song is
+ *  rendered with the firmware modules (one independent instance per worker
+ *  thread) and the resulting audio is analysed: peak level, number of clipped
+ *  samples, RMS level and spectral centroid.  The jobs are spread on all the
+ *  cores with a work-stealing thread pool and a compact summary table is
+ *  written at the end, in grid order.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "thread_pool.h"
+
+extern "C" {
+#include "button_manager.h"
+#include "control_loop.h"
+#include "ecu_bus.h"
+#include "sound_manager.h"
+#include "tractor_model.h"
+}
+
+static const unsigned SAMPLE_RATE_HZ    = 8000;
+static const unsigned FFT_SIZE          = 1024;
+
+static const uint8_t ADC_LEVEL_OFF      = 0;
+static const uint8_t ADC_LEVEL_ON       = 56;
+static const uint8_t ADC_LEVEL_ON_START = 128;
+
+/**
+ *  An ignition sequence is a list of button levels, each one held for a given
+ *  number of model ticks (40 ms).  The last level is held until the end.
+ */
+struct IgnitionStep {
+    unsigned    ticks;
+    uint8_t     adcButtons;
+};
+
+struct IgnitionSequence {
+    const char                  *name;
+    std::vector<IgnitionStep>   steps;
+};
+
+static const std::vector<IgnitionSequence> IGNITION_SEQUENCES = {
+    {"start", {{25, ADC_LEVEL_OFF}, {125, ADC_LEVEL_ON_START}, {0, ADC_LEVEL_ON}}},
+    {"short-crank", {{25, ADC_LEVEL_OFF}, {50, ADC_LEVEL_ON_START}, {25, ADC_LEVEL_ON},
+            {125, ADC_LEVEL_ON_START}, {0, ADC_LEVEL_ON}}},
+    {"stop-restart", {{25, ADC_LEVEL_OFF}, {125, ADC_LEVEL_ON_START}, {150, ADC_LEVEL_ON},
+            {50, ADC_LEVEL_OFF}, {125, ADC_LEVEL_ON_START}, {0, ADC_LEVEL_ON}}},
+};
+
+static const std::vector<uint8_t> THROTTLE_SETPOINTS = {38, 70, 102, 134, 166, 198, 230};
+
+static const char *SONG_NAMES[] = {"single", "double", "dixie", "none"};
+static_assert(sizeof(SONG_NAMES) / sizeof(*SONG_NAMES) == SONG_COUNT + 1,
+        "SONG_NAMES must name every song, plus none");
+static const unsigned SONG_START_TICK = 8 * 25;
+
+struct Job {
+    const IgnitionSequence  *sequence;
+    uint8_t                 adcThrottle;
+    uint8_t                 song;           // SONG_COUNT means no song
+};
+
+struct Analysis {
+    unsigned    peak;           // maximum distance from the 128 mid level
+    unsigned    clipped;        // samples saturated to 0 or 255
+    double      rms;
+    double      centroidHz;
+};
+
+static uint8_t buttonLevel(const IgnitionSequence &sequence, unsigned tick)
+{
+    for (const auto &step : sequence.steps) {
+        if (step.ticks == 0 || tick < step.ticks)
+            return step.adcButtons;
+        tick -= step.ticks;
+    }
+    return sequence.steps.back().adcButtons;
+}
+
+/**
+ *  Render the audio for a job, running the main loop body of the firmware
+ *  (control_loop.h).
+ *  @note The module state is thread local, so jobs running on different
+ *  threads do not interfere with each other.
+ */
+static std::vector<uint8_t> render(const Job &job, unsigned seconds)
+{
+    button_reset();
+    tractor_reset();
+    audio_reset();
+    ecu_bus_reset();
+    control_reset();
+
+    std::vector<uint8_t> samples(seconds * SAMPLE_RATE_HZ);
+    unsigned tick = 0;
+
+    for (size_t i = 0; i < samples.size(); ++i) {
+        samples[i] = control_get_next_sample();
+
+        if (control_is_model_update_due()) {
+            // any song can be requested, not only "Dixie" from the horn button
+            if (tick == SONG_START_TICK && job.song < SONG_COUNT)
+                audio_play_horn_song(job.song);
+
+            control_update_model(job.adcThrottle, buttonLevel(*job.sequence, tick));
+
+            // the frames sent to the slave ECU are not analysed
+            uint8_t byte;
+            while (ecu_bus_loopback_read(&byte))
+                ;
+            ++tick;
+        }
+    }
+    return samples;
+}
+
+static void fft(std::vector<std::complex<double>> &data)
+{
+    const size_t n = data.size();
+    for (size_t i = 1, j = 0; i < n; ++i) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+        if (i < j)
+            std::swap(data[i], data[j]);
+    }
+
+    for (size_t length = 2; length <= n; length <<= 1) {
+        const std::complex<double> step = std::polar(1.0, -2.0 * M_PI / length);
+        for (size_t i = 0; i < n; i += length) {
+            std::complex<double> w{1.0};
+            for (size_t k = 0; k < length / 2; ++k) {
+                auto even = data[i + k];
+                auto odd = data[i + k + length / 2] * w;
+                data[i + k] = even + odd;
+                data[i + k + length / 2] = even - odd;
+                w *= step;
+            }
+        }
+    }
+}
+
+static Analysis analyse(const std::vector<uint8_t> &samples)
+{
+    Analysis analysis{0, 0, 0.0, 0.0};
+    double energy = 0.0;
+    for (auto sample : samples) {
+        int value = static_cast<int>(sample) - 128;
+        analysis.peak = std::max(analysis.peak, static_cast<unsigned>(std::abs(value)));
+        analysis.clipped += (sample == 0 || sample == 255);
+        energy += value * value;
+    }
+    analysis.rms = std::sqrt(energy / samples.size());
+
+    // Magnitude spectrum accumulated over consecutive Hann windowed frames
+    std::vector<double> spectrum(FFT_SIZE / 2, 0.0);
+    std::vector<std::complex<double>> frame(FFT_SIZE);
+    for (size_t start = 0; start + FFT_SIZE <= samples.size(); start += FFT_SIZE) {
+        for (unsigned i = 0; i < FFT_SIZE; ++i) {
+            double window = 0.5 - 0.5 * std::cos(2.0 * M_PI * i / (FFT_SIZE - 1));
+            frame[i] = (static_cast<int>(samples[start + i]) - 128) * window;
+        }
+        fft(frame);
+        for (unsigned i = 0; i < FFT_SIZE / 2; ++i)
+            spectrum[i] += std::abs(frame[i]);
+    }
+
+    double weighted = 0.0, total = 0.0;
+    for (unsigned i = 1; i < FFT_SIZE / 2; ++i) {
+        weighted += spectrum[i] * i * SAMPLE_RATE_HZ / FFT_SIZE;
+        total += spectrum[i];
+    }
+    analysis.centroidHz = total > 0.0 ? weighted / total : 0.0;
+    return analysis;
+}
+
+static void usage(const char *program)
+{
+    std::printf("usage: %s [--threads N] [--seconds S] [--output FILE]\n", program);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned threads = std::thread::hardware_concurrency();
+    unsigned seconds = 30;
+    const char *outputFile = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--threads") && i + 1 < argc)
+            threads = std::max(1, std::atoi(argv[++i]));
+        else if (!std::strcmp(argv[i], "--seconds") && i + 1 < argc)
+            seconds = std::max(1, std::atoi(argv[++i]));
+        else if (!std::strcmp(argv[i], "--output") && i + 1 < argc)
+            outputFile = argv[++i];
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    std::vector<Job> jobs;
+    for (const auto &sequence : IGNITION_SEQUENCES)
+        for (auto throttle : THROTTLE_SETPOINTS)
+            for (uint8_t song = 0; song <= SONG_COUNT; ++song)
+                jobs.push_back({&sequence, throttle, song});
+
+    std::vector<Analysis> results(jobs.size());
+    auto start = std::chrono::steady_clock::now();
+    {
+        ThreadPool pool{threads};
+        threads = pool.size();
+        for (size_t i = 0; i < jobs.size(); ++i)
+            pool.submit([&, i] { results[i] = analyse(render(jobs[i], seconds)); });
+        pool.wait();
+    }
+    std::chrono::duration<double> elapsed{std::chrono::steady_clock::now() - start};
+
+    FILE *output = outputFile ? std::fopen(outputFile, "w") : stdout;
+    if (!output) {
+        std::perror(outputFile);
+        return 1;
+    }
+
+    std::fprintf(output, "%-13s %8s %-7s %5s %8s %7s %12s\n", "sequence",
+            "throttle", "song", "peak", "clipped", "rms", "centroid_hz");
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        const auto &job = jobs[i];
+        const auto &result = results[i];
+        std::fprintf(output, "%-13s %8u %-7s %5u %8u %7.2f %12.1f\n",
+                job.sequence->name, job.adcThrottle, SONG_NAMES[job.song],
+                result.peak, result.clipped, result.rms, result.centroidHz);
+    }
+    if (output != stdout)
+        std::fclose(output);
+
+    std::fprintf(stderr, "%zu renders of %u s on %u threads in %.2f s\n",
+            jobs.size(), seconds, threads, elapsed.count());
+    return 0;
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ *  Thread pool with per-worker task queues and work stealing.
+ *
+ *  Tasks are distributed round-robin on the worker queues.  Every worker pops
+ *  tasks from the front of its own queue and, when it runs out of work,
+ *  steals from the back of the queues of the other workers, so long and
+ *  short tasks balance out without a single contended queue.
+ */
+class ThreadPool
+{
+public:
+    using Task = std::function<void()>;
+
+    explicit ThreadPool(unsigned threads = std::thread::hardware_concurrency()) :
+        m_queues(threads ? threads : 1)
+    {
+        for (auto &queue : m_queues)
+            queue.reset(new Queue);
+        for (unsigned i = 0; i < m_queues.size(); ++i)
+            m_workers.emplace_back(&ThreadPool::worker, this, i);
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            m_stop = true;
+        }
+        m_wakeUp.notify_all();
+        for (auto &worker : m_workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(m_queues.size()); }
+
+    void submit(Task task)
+    {
+        auto &queue = *m_queues[m_next++ % m_queues.size()];
+        {
+            std::lock_guard<std::mutex> lock{queue.mutex};
+            queue.tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            ++m_pending;
+            ++m_queued;
+        }
+        m_wakeUp.notify_one();
+    }
+
+    // Block until all the submitted tasks are complete
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        m_done.wait(lock, [this] { return m_pending == 0; });
+    }
+
+private:
+    struct Queue {
+        std::mutex          mutex;
+        std::deque<Task>    tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread>            m_workers;
+    std::atomic<size_t>                 m_next{0};
+
+    std::mutex                          m_mutex;
+    std::condition_variable             m_wakeUp;
+    std::condition_variable             m_done;
+    size_t                              m_pending{0};   // submitted, not complete
+    std::atomic<size_t>                 m_queued{0};    // submitted, not started
+    bool                                m_stop{false};
+
+    bool pop(unsigned index, Task &task)
+    {
+        auto &own = *m_queues[index];
+        {
+            std::lock_guard<std::mutex> lock{own.mutex};
+            if (!own.tasks.empty()) {
+                task = std::move(own.tasks.front());
+                own.tasks.pop_front();
+                --m_queued;
+                return true;
+            }
+        }
+
+        for (size_t i = 1; i < m_queues.size(); ++i) {
+            auto &victim = *m_queues[(index + i) % m_queues.size()];
+            std::lock_guard<std::mutex> lock{victim.mutex};
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.back());
+                victim.tasks.pop_back();
+                --m_queued;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void worker(unsigned index)
+    {
+        for (;;) {
+            Task task;
+            if (pop(index, task)) {
+                task();
+
+                std::lock_guard<std::mutex> lock{m_mutex};
+                if (--m_pending == 0)
+                    m_done.notify_all();
+                continue;
+            }
+
+            // m_queued is incremented under m_mutex, so no wake up is lost
+            std::unique_lock<std::mutex> lock{m_mutex};
+            m_wakeUp.wait(lock, [this] { return m_stop || m_queued > 0; });
+            if (m_stop && m_queued == 0)
+                return;
+        }
+    }
+};
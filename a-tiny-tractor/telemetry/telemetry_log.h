@@ -0,0 +1,320 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+/**
+ *  Columnar telemetry log.
+ *
+ *  A log stores one row per model tick (25 Hz) and, optionally, the audio
+ *  samples rendered during the tick.  The file is append-only and is made of
+ *  a file header followed by self-contained chunks:
+ *
+ *      FileHeader
+ *      ChunkHeader | column 0 | column 1 | ... | column N-1 | [audio]
+ *      ChunkHeader | column 0 | ...
+ *
+ *  Inside a chunk every column is a contiguous array of @a rowCount values,
+ *  padded to 8 bytes, so a reader can map the file and scan a single column
+ *  without touching the others.  Chunks are written only when complete, so a
+ *  log cut by a crash or a power loss is still valid up to its last chunk.
+ *  All the values are stored little endian.
+ */
+namespace telemetry {
+
+static const char       FILE_MAGIC[8]       = {'T', 'R', 'A', 'C', 'T', 'L', 'O', 'G'};
+static const uint32_t   CHUNK_MAGIC         = 0x4b4e4843;  // "CHNK"
+static const uint16_t   FORMAT_VERSION      = 1;
+static const uint16_t   ROW_RATE_HZ         = 25;
+static const uint16_t   AUDIO_SAMPLES_PER_ROW = 8000 / ROW_RATE_HZ;
+static const uint32_t   ROWS_PER_CHUNK      = 60 * ROW_RATE_HZ;
+
+enum Column {
+    COLUMN_TICK,            // uint32_t: model tick counter
+    COLUMN_ENGINE_SPEED,    // uint8_t:  engine speed (BP6, 64 = 800 rpm)
+    COLUMN_ENGINE_STATUS,   // uint8_t:  ENGINE_STATUS_OFF/CRANKING/RUNNING
+    COLUMN_LED,             // uint8_t:  LED status
+    COLUMN_MOTOR_DUTY,      // uint8_t:  DC motor duty cycle (6 bit)
+    COLUMN_HORN_NOTE,       // uint8_t:  horn index increment (0 = silent)
+    COLUMN_LOOP_CYCLES,     // uint16_t: loop passes (or samples) during the tick
+    COLUMN_OVERRUNS,        // uint8_t:  tick periods missed before this row
+    COLUMN_COUNT
+};
+
+struct ColumnInfo {
+    char        name[14];
+    uint8_t     width;
+    uint8_t     reserved;
+};
+
+static const ColumnInfo COLUMNS[COLUMN_COUNT] = {
+    {"tick",            4, 0},
+    {"engine_speed",    1, 0},
+    {"engine_status",   1, 0},
+    {"led",             1, 0},
+    {"motor_duty",      1, 0},
+    {"horn_note",       1, 0},
+    {"loop_cycles",     2, 0},
+    {"overruns",        1, 0},
+};
+
+struct FileHeader {
+    char        magic[8];
+    uint16_t    version;
+    uint16_t    rowRateHz;
+    uint16_t    audioSamplesPerRow;     // 0 when the log has no audio
+    uint16_t    columnCount;
+    uint32_t    rowsPerChunk;
+    uint32_t    reserved;
+    ColumnInfo  columns[COLUMN_COUNT];
+};
+
+struct ChunkHeader {
+    uint32_t    magic;
+    uint32_t    rowCount;
+    uint64_t    payloadSize;            // bytes following the chunk header
+};
+
+static_assert(sizeof(FileHeader) % 8 == 0, "FileHeader must keep chunks aligned");
+static_assert(sizeof(ChunkHeader) % 8 == 0, "ChunkHeader must keep columns aligned");
+
+struct Record {
+    uint32_t    tick;
+    uint8_t     engineSpeed;
+    uint8_t     engineStatus;
+    uint8_t     led;
+    uint8_t     motorDuty;
+    uint8_t     hornNote;
+    uint16_t    loopCycles;
+    uint8_t     overruns;
+};
+
+inline size_t alignedSize(size_t size)
+{
+    return (size + 7) & ~static_cast<size_t>(7);
+}
+
+// Size of a column (or of the audio block) of a chunk with the given rows
+inline size_t columnSize(unsigned column, uint32_t rows)
+{
+    return alignedSize(static_cast<size_t>(COLUMNS[column].width) * rows);
+}
+
+// Size of the payload of a chunk with the given rows (columns and audio)
+inline uint64_t chunkPayloadSize(uint32_t rows, uint16_t audioSamplesPerRow)
+{
+    uint64_t size = alignedSize(static_cast<size_t>(rows) * audioSamplesPerRow);
+    for (unsigned column = 0; column < COLUMN_COUNT; ++column)
+        size += columnSize(column, rows);
+    return size;
+}
+
+/**
+ *  Background writer of a telemetry log.
+ *
+ *  The producer (the simulator timer or a recording loop) pushes rows into a
+ *  single-producer single-consumer ring buffer that never blocks: when the
+ *  writer thread falls behind, the row is dropped and counted.  The writer
+ *  thread transposes the rows into the column buffers of the current chunk
+ *  and appends the chunk to the file once it is full, or at close.
+ */
+class Writer
+{
+public:
+    explicit Writer(size_t capacity = 8192) :
+        m_capacity{capacity},
+        m_rows(capacity)
+    {
+    }
+
+    ~Writer()
+    {
+        close();
+    }
+
+    Writer(const Writer &) = delete;
+    Writer &operator=(const Writer &) = delete;
+
+    bool open(const char *fileName, bool audio)
+    {
+        close();
+
+        m_file = std::fopen(fileName, "wb");
+        if (!m_file)
+            return false;
+
+        m_audioSamplesPerRow = audio ? AUDIO_SAMPLES_PER_ROW : 0;
+        m_audio.assign(m_capacity * m_audioSamplesPerRow, 0);
+
+        FileHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, FILE_MAGIC, sizeof(header.magic));
+        header.version              = FORMAT_VERSION;
+        header.rowRateHz            = ROW_RATE_HZ;
+        header.audioSamplesPerRow   = m_audioSamplesPerRow;
+        header.columnCount          = COLUMN_COUNT;
+        header.rowsPerChunk         = ROWS_PER_CHUNK;
+        std::memcpy(header.columns, COLUMNS, sizeof(COLUMNS));
+        m_ok = std::fwrite(&header, sizeof(header), 1, m_file) == 1;
+
+        for (unsigned column = 0; column < COLUMN_COUNT; ++column)
+            m_chunk[column].assign(columnSize(column, ROWS_PER_CHUNK), 0);
+        m_chunkAudio.assign(alignedSize(ROWS_PER_CHUNK * m_audioSamplesPerRow), 0);
+        m_chunkRows = 0;
+
+        m_head = 0;
+        m_tail = 0;
+        m_dropped = 0;
+        m_stop = false;
+        m_thread = std::thread{&Writer::run, this};
+        return m_ok;
+    }
+
+    // Flush the pending rows, write the last (partial) chunk and close the file
+    bool close()
+    {
+        if (!m_file)
+            return true;
+
+        m_stop = true;
+        m_thread.join();
+        drain();
+        writeChunk();
+
+        m_ok = (std::fclose(m_file) == 0) && m_ok;
+        m_file = nullptr;
+        return m_ok;
+    }
+
+    /**
+     *  Queue a row (and its audio samples, when the log has audio).  Never
+     *  blocks: returns false and counts the row as dropped if the queue is
+     *  full.  Must always be called from the same thread.
+     */
+    bool push(const Record &record, const uint8_t *audio = nullptr)
+    {
+        auto head = m_head.load(std::memory_order_relaxed);
+        if (head - m_tail.load(std::memory_order_acquire) == m_capacity) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        auto slot = head % m_capacity;
+        m_rows[slot] = record;
+        if (m_audioSamplesPerRow) {
+            auto destination = &m_audio[slot * m_audioSamplesPerRow];
+            if (audio)
+                std::memcpy(destination, audio, m_audioSamplesPerRow);
+            else
+                std::memset(destination, 128, m_audioSamplesPerRow);
+        }
+
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+    bool ok() const { return m_ok; }
+
+private:
+    size_t                  m_capacity;
+    std::vector<Record>     m_rows;
+    std::vector<uint8_t>    m_audio;
+    std::atomic<size_t>     m_head{0};
+    std::atomic<size_t>     m_tail{0};
+    std::atomic<uint64_t>   m_dropped{0};
+    std::atomic<bool>       m_stop{false};
+    std::thread             m_thread;
+
+    std::FILE               *m_file = nullptr;
+    bool                    m_ok = false;
+    uint16_t                m_audioSamplesPerRow = 0;
+    std::vector<uint8_t>    m_chunk[COLUMN_COUNT];
+    std::vector<uint8_t>    m_chunkAudio;
+    uint32_t                m_chunkRows = 0;
+
+    void run()
+    {
+        while (!m_stop.load(std::memory_order_acquire)) {
+            if (!drain())
+                std::this_thread::sleep_for(std::chrono::milliseconds{20});
+        }
+    }
+
+    // Move the queued rows into the current chunk, return false if idle
+    bool drain()
+    {
+        auto tail = m_tail.load(std::memory_order_relaxed);
+        auto head = m_head.load(std::memory_order_acquire);
+        if (tail == head)
+            return false;
+
+        for (; tail != head; ++tail) {
+            auto slot = tail % m_capacity;
+            append(m_rows[slot], m_audioSamplesPerRow ?
+                    &m_audio[slot * m_audioSamplesPerRow] : nullptr);
+            if (m_chunkRows == ROWS_PER_CHUNK)
+                writeChunk();
+        }
+
+        m_tail.store(tail, std::memory_order_release);
+        return true;
+    }
+
+    template <typename T>
+    void store(unsigned column, T value)
+    {
+        std::memcpy(&m_chunk[column][m_chunkRows * sizeof(T)], &value, sizeof(T));
+    }
+
+    void append(const Record &record, const uint8_t *audio)
+    {
+        store(COLUMN_TICK,          record.tick);
+        store(COLUMN_ENGINE_SPEED,  record.engineSpeed);
+        store(COLUMN_ENGINE_STATUS, record.engineStatus);
+        store(COLUMN_LED,           record.led);
+        store(COLUMN_MOTOR_DUTY,    record.motorDuty);
+        store(COLUMN_HORN_NOTE,     record.hornNote);
+        store(COLUMN_LOOP_CYCLES,   record.loopCycles);
+        store(COLUMN_OVERRUNS,      record.overruns);
+        if (audio)
+            std::memcpy(&m_chunkAudio[m_chunkRows * m_audioSamplesPerRow],
+                    audio, m_audioSamplesPerRow);
+        ++m_chunkRows;
+    }
+
+    void writeChunk()
+    {
+        if (!m_chunkRows)
+            return;
+
+        ChunkHeader header;
+        header.magic        = CHUNK_MAGIC;
+        header.rowCount     = m_chunkRows;
+        header.payloadSize  = chunkPayloadSize(m_chunkRows, m_audioSamplesPerRow);
+
+        m_ok = std::fwrite(&header, sizeof(header), 1, m_file) == 1 && m_ok;
+        for (unsigned column = 0; column < COLUMN_COUNT; ++column) {
+            // keep the padding bytes deterministic
+            auto size = columnSize(column, m_chunkRows);
+            auto used = COLUMNS[column].width * m_chunkRows;
+            std::memset(m_chunk[column].data() + used, 0, size - used);
+            m_ok = std::fwrite(m_chunk[column].data(), size, 1, m_file) == 1 && m_ok;
+        }
+        if (m_audioSamplesPerRow) {
+            auto size = alignedSize(m_chunkRows * m_audioSamplesPerRow);
+            auto used = m_chunkRows * m_audioSamplesPerRow;
+            std::memset(m_chunkAudio.data() + used, 0, size - used);
+            m_ok = std::fwrite(m_chunkAudio.data(), size, 1, m_file) == 1 && m_ok;
+        }
+        std::fflush(m_file);
+        m_chunkRows = 0;
+    }
+};
+
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "telemetry_log.h"
+
+namespace telemetry {
+
+/**
+ *  Read-only view of a chunk of a mapped log.  Column pointers refer directly
+ *  to the mapped file.
+ */
+struct Chunk {
+    uint32_t        rowCount;
+    const uint8_t   *column[COLUMN_COUNT];
+    const uint8_t   *audio;                 // nullptr when the log has no audio
+
+    template <typename T>
+    const T *values(Column index) const
+    {
+        return reinterpret_cast<const T *>(column[index]);
+    }
+};
+
+/**
+ *  Memory-mapped reader of a telemetry log.
+ *
+ *  The whole file is mapped read-only and chunks are visited in order
+ *  without copies; the kernel pages in only the columns actually touched.
+ *  A truncated trailing chunk (e.g. the log of a session still running) is
+ *  silently ignored.
+ */
+class Reader
+{
+public:
+    Reader() = default;
+
+    ~Reader()
+    {
+        close();
+    }
+
+    Reader(const Reader &) = delete;
+    Reader &operator=(const Reader &) = delete;
+
+    bool open(const char *fileName)
+    {
+        close();
+
+        int fd = ::open(fileName, O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size >= static_cast<off_t>(sizeof(FileHeader))) {
+            m_size = static_cast<size_t>(info.st_size);
+            void *data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                m_data = static_cast<const uint8_t *>(data);
+                madvise(data, m_size, MADV_SEQUENTIAL);
+            }
+        }
+        ::close(fd);
+
+        if (!m_data)
+            return false;
+
+        std::memcpy(&m_header, m_data, sizeof(m_header));
+        if (std::memcmp(m_header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) ||
+                m_header.version != FORMAT_VERSION ||
+                m_header.columnCount != COLUMN_COUNT) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+        if (m_data)
+            munmap(const_cast<uint8_t *>(m_data), m_size);
+        m_data = nullptr;
+        m_size = 0;
+    }
+
+    const FileHeader &header() const { return m_header; }
+
+    // Call function(const Chunk &) for every complete chunk, return the rows
+    template <typename F>
+    uint64_t forEachChunk(F &&function) const
+    {
+        uint64_t rows = 0;
+        size_t offset = sizeof(FileHeader);
+
+        while (offset + sizeof(ChunkHeader) <= m_size) {
+            ChunkHeader header;
+            std::memcpy(&header, m_data + offset, sizeof(header));
+            offset += sizeof(header);
+            if (header.magic != CHUNK_MAGIC || header.payloadSize > m_size - offset)
+                break;
+            // the columns are located from the row count: reject a chunk
+            // whose payload does not hold them exactly
+            if (header.payloadSize != chunkPayloadSize(header.rowCount,
+                    m_header.audioSamplesPerRow))
+                break;
+
+            Chunk chunk;
+            chunk.rowCount = header.rowCount;
+            auto position = offset;
+            for (unsigned column = 0; column < COLUMN_COUNT; ++column) {
+                chunk.column[column] = m_data + position;
+                position += columnSize(column, header.rowCount);
+            }
+            chunk.audio = m_header.audioSamplesPerRow ? m_data + position : nullptr;
+
+            function(static_cast<const Chunk &>(chunk));
+            rows += header.rowCount;
+            offset += header.payloadSize;
+        }
+
+        return rows;
+    }
+
+private:
+    const uint8_t   *m_data = nullptr;
+    size_t          m_size = 0;
+    FileHeader      m_header;
+};
+
+}
@@ -0,0 +1,379 @@
+/*
+ *  Telemetry log tool.
+ *
+ *  tlog record FILE [--hours H] [--audio] [--seed S]
+ *      Run the firmware modules through a scripted (pseudo random) driving
+ *      session and store it as a telemetry log, mostly useful to produce
+ *      long logs for the analysis.
+ *
+ *  tlog analyze FILE
+ *      Map a telemetry log and compute, in a single pass over the columns,
+ *      the time spent in each engine state, the RPM histogram, the LED,
+ *      motor and horn activity, the loop cycles and the overrun rate.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "telemetry_log.h"
+#include "telemetry_reader.h"
+
+extern "C" {
+#include "button_manager.h"
+#include "control_loop.h"
+#include "ecu_bus.h"
+#include "sound_manager.h"
+#include "tractor_model.h"
+}
+
+static const unsigned MODEL_CYCLE       = telemetry::AUDIO_SAMPLES_PER_ROW;
+static_assert(telemetry::AUDIO_SAMPLES_PER_ROW == CONTROL_MODEL_CYCLE,
+        "A row must hold the audio of one model update");
+
+static const uint8_t ADC_LEVEL_OFF      = 0;
+static const uint8_t ADC_LEVEL_ON       = 56;
+static const uint8_t ADC_LEVEL_ON_HORN  = 70;
+static const uint8_t ADC_LEVEL_ON_START = 128;
+
+static const uint8_t PWM_MIN            = 6;
+static const uint8_t PWM_MAX            = 58;
+
+static const unsigned RPM_BIN           = 100;
+static const unsigned RPM_BINS          = 22;
+
+// Engine speed is BP6 with 64 meaning 800 rpm
+static unsigned engineRpm(uint8_t engineSpeed)
+{
+    return engineSpeed * 25u / 2u;
+}
+
+// Same mapping as motorDutyCycle in slave_ecu/slave_ecu.ino
+static uint8_t motorDuty(uint8_t engineSpeed)
+{
+    if (engineSpeed < ENGINE_SPEED_MIN)
+        return 0;
+    return std::min<uint8_t>(PWM_MAX, PWM_MIN + ((engineSpeed - ENGINE_SPEED_IDLE) >> 1));
+}
+
+/**
+ *  Deterministic driving script: the key is turned on, the engine cranked and
+ *  then driven with random throttle changes and horn honks, until the key is
+ *  turned off and the tractor rests for a while.
+ */
+class Driver
+{
+public:
+    explicit Driver(uint32_t seed) : m_seed{seed ? seed : 1} {}
+
+    // a honk presses the horn button for a single tick
+    uint8_t buttons() const { return m_honk ? ADC_LEVEL_ON_HORN : m_buttons; }
+
+    // throttle ADC value converted back to the setpoint by the firmware
+    uint8_t throttle() const
+    {
+        return static_cast<uint8_t>(ADC_THROTTLE_IDLE + ((m_setpoint - ENGINE_SPEED_IDLE) << 1));
+    }
+
+    void tick()
+    {
+        m_honk = false;
+        if (m_remaining) {
+            --m_remaining;
+            if (m_phase == PHASE_DRIVE && random(2000) == 0)
+                m_honk = true;
+            return;
+        }
+
+        switch (m_phase) {
+        case PHASE_REST:
+            m_phase     = PHASE_CRANK;
+            m_buttons   = ADC_LEVEL_ON_START;
+            m_setpoint  = ENGINE_SPEED_IDLE;
+            m_remaining = 25 + random(150);
+            break;
+        case PHASE_CRANK:
+        case PHASE_DRIVE:
+            m_buttons = ADC_LEVEL_ON;
+            if (m_phase == PHASE_DRIVE && random(20) == 0) {
+                m_phase     = PHASE_REST;
+                m_buttons   = ADC_LEVEL_OFF;
+                m_remaining = 25 * (10 + random(600));
+            } else {
+                m_phase     = PHASE_DRIVE;
+                m_setpoint  = ENGINE_SPEED_IDLE +
+                        random(ENGINE_SPEED_MAX - ENGINE_SPEED_IDLE + 1);
+                m_remaining = 25 * (2 + random(30));
+            }
+            break;
+        }
+    }
+
+private:
+    enum Phase { PHASE_REST, PHASE_CRANK, PHASE_DRIVE };
+
+    uint32_t    m_seed;
+    Phase       m_phase = PHASE_REST;
+    unsigned    m_remaining = 25;
+    uint8_t     m_buttons = ADC_LEVEL_OFF;
+    uint8_t     m_setpoint = ENGINE_SPEED_IDLE;
+    bool        m_honk = false;
+
+    unsigned random(unsigned range)
+    {
+        m_seed = m_seed * 1664525u + 1013904223u;
+        return (m_seed >> 8) % range;
+    }
+};
+
+static int record(const char *fileName, double hours, bool withAudio, uint32_t seed)
+{
+    telemetry::Writer writer;
+    if (!writer.open(fileName, withAudio)) {
+        std::fprintf(stderr, "cannot create %s\n", fileName);
+        return 1;
+    }
+
+    button_reset();
+    tractor_reset();
+    audio_reset();
+    ecu_bus_reset();
+    control_reset();
+
+    Driver driver{seed};
+    uint8_t audio[MODEL_CYCLE];
+    EcuDecoder ecuDecoder = {};
+    EcuFrame ecuFrame = {};
+    const auto ticks = static_cast<uint32_t>(hours * 3600 * telemetry::ROW_RATE_HZ);
+    const auto start = std::chrono::steady_clock::now();
+
+    for (uint32_t tick = 0; tick < ticks; ++tick) {
+        // the main loop body of the firmware (control_loop.h)
+        for (unsigned i = 0; i < MODEL_CYCLE; ++i)
+            audio[i] = control_get_next_sample();
+
+        driver.tick();
+        control_update_model(driver.throttle(), driver.buttons());
+
+        // the LED and the motor are the outputs of the slave ECU for the frames on the bus
+        uint8_t byte;
+        EcuFrame frame;
+        while (ecu_bus_loopback_read(&byte)) {
+            if (ecu_bus_decode(&ecuDecoder, byte, &frame) && frame.kind != ECU_FRAME_DIAGNOSTIC)
+                ecuFrame = frame;
+        }
+
+        telemetry::Record row;
+        row.tick            = tick;
+        row.engineSpeed     = tractor_get_engine_speed();
+        row.engineStatus    = tractor_get_engine_status();
+        row.led             = (ecuFrame.lights & ECU_LIGHT_BEACON) != 0;
+        row.motorDuty       = motorDuty(ecuFrame.engine_speed);
+        row.hornNote        = audio_get_horn_note();
+        row.loopCycles      = MODEL_CYCLE;
+        row.overruns        = 0;
+
+        // the recording loop is the producer: spin instead of dropping rows
+        while (!writer.push(row, audio))
+            std::this_thread::yield();
+    }
+
+    bool ok = writer.close();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::fprintf(stderr, "%u rows (%.1f h) recorded in %.2f s\n",
+            ticks, hours, elapsed.count());
+    if (!ok)
+        std::fprintf(stderr, "error while writing %s\n", fileName);
+    return ok ? 0 : 1;
+}
+
+static std::string duration(uint64_t rows)
+{
+    auto seconds = rows / telemetry::ROW_RATE_HZ;
+    char text[32];
+    std::snprintf(text, sizeof(text), "%3llu:%02u:%02u",
+            static_cast<unsigned long long>(seconds / 3600),
+            static_cast<unsigned>(seconds / 60 % 60), static_cast<unsigned>(seconds % 60));
+    return text;
+}
+
+static double percent(uint64_t part, uint64_t total)
+{
+    return total ? 100.0 * part / total : 0.0;
+}
+
+struct Statistics {
+    uint64_t    chunks = 0;
+    uint64_t    gaps = 0;           // tick discontinuities (dropped rows or missed periods)
+    bool        first = true;
+    uint32_t    lastTick = 0;
+    uint64_t    status[3] = {0, 0, 0};
+    uint64_t    rpm[RPM_BINS] = {0};
+    uint64_t    ledOn = 0;
+    uint64_t    motorSum = 0;
+    uint64_t    motorOn = 0;
+    uint64_t    hornOn = 0;
+    uint64_t    hornNotes = 0;
+    uint8_t     lastNote = 0;
+    uint64_t    loopSum = 0;
+    uint16_t    loopMin = UINT16_MAX;
+    uint16_t    loopMax = 0;
+    uint64_t    overruns = 0;
+    uint64_t    overrunRows = 0;
+    uint64_t    audioSamples = 0;
+    uint64_t    audioClipped = 0;
+    unsigned    audioPeak = 0;
+};
+
+static void accumulate(Statistics &stats, const telemetry::Chunk &chunk, unsigned audioSamplesPerRow)
+{
+    using namespace telemetry;
+
+    auto tick       = chunk.values<uint32_t>(COLUMN_TICK);
+    auto speed      = chunk.values<uint8_t>(COLUMN_ENGINE_SPEED);
+    auto status     = chunk.values<uint8_t>(COLUMN_ENGINE_STATUS);
+    auto led        = chunk.values<uint8_t>(COLUMN_LED);
+    auto motor      = chunk.values<uint8_t>(COLUMN_MOTOR_DUTY);
+    auto horn       = chunk.values<uint8_t>(COLUMN_HORN_NOTE);
+    auto loop       = chunk.values<uint16_t>(COLUMN_LOOP_CYCLES);
+    auto overruns   = chunk.values<uint8_t>(COLUMN_OVERRUNS);
+
+    ++stats.chunks;
+    for (uint32_t i = 0; i < chunk.rowCount; ++i) {
+        if (!stats.first && tick[i] != stats.lastTick + 1)
+            ++stats.gaps;
+        stats.first = false;
+        stats.lastTick = tick[i];
+
+        stats.status[std::min<uint8_t>(status[i], ENGINE_STATUS_RUNNING)]++;
+        if (status[i] == ENGINE_STATUS_RUNNING)
+            stats.rpm[std::min(engineRpm(speed[i]) / RPM_BIN, RPM_BINS - 1)]++;
+
+        stats.ledOn += led[i] != 0;
+        stats.motorSum += motor[i];
+        stats.motorOn += motor[i] != 0;
+
+        stats.hornOn += horn[i] != 0;
+        stats.hornNotes += horn[i] != 0 && horn[i] != stats.lastNote;
+        stats.lastNote = horn[i];
+
+        stats.loopSum += loop[i];
+        stats.loopMin = std::min(stats.loopMin, loop[i]);
+        stats.loopMax = std::max(stats.loopMax, loop[i]);
+        stats.overruns += overruns[i];
+        stats.overrunRows += overruns[i] != 0;
+    }
+
+    if (chunk.audio) {
+        auto samples = static_cast<size_t>(chunk.rowCount) * audioSamplesPerRow;
+        for (size_t i = 0; i < samples; ++i) {
+            auto sample = chunk.audio[i];
+            stats.audioPeak = std::max(stats.audioPeak,
+                    static_cast<unsigned>(std::abs(static_cast<int>(sample) - 128)));
+            stats.audioClipped += (sample == 0 || sample == 255);
+        }
+        stats.audioSamples += samples;
+    }
+}
+
+static int analyze(const char *fileName)
+{
+    telemetry::Reader reader;
+    if (!reader.open(fileName)) {
+        std::fprintf(stderr, "%s is not a telemetry log\n", fileName);
+        return 1;
+    }
+
+    Statistics stats;
+    const auto audioSamplesPerRow = reader.header().audioSamplesPerRow;
+    const auto rows = reader.forEachChunk([&](const telemetry::Chunk &chunk) {
+            accumulate(stats, chunk, audioSamplesPerRow);
+        });
+
+    std::printf("file        %s\n", fileName);
+    std::printf("rows        %llu in %llu chunks, %s (h:mm:ss), %llu gaps\n",
+            static_cast<unsigned long long>(rows),
+            static_cast<unsigned long long>(stats.chunks),
+            duration(rows).c_str(), static_cast<unsigned long long>(stats.gaps));
+    if (!rows)
+        return 0;
+
+    static const char *STATUS_NAMES[] = {"off", "cranking", "running"};
+    std::printf("\ntime in state\n");
+    for (unsigned i = 0; i < 3; ++i)
+        std::printf("  %-9s %s  %6.2f %%\n", STATUS_NAMES[i],
+                duration(stats.status[i]).c_str(), percent(stats.status[i], rows));
+
+    std::printf("\nrpm histogram (engine running)\n");
+    const auto running = stats.status[ENGINE_STATUS_RUNNING];
+    const auto peak = *std::max_element(stats.rpm, stats.rpm + RPM_BINS);
+    for (unsigned i = 0; i < RPM_BINS; ++i) {
+        if (!stats.rpm[i])
+            continue;
+        std::printf("  %4u-%4u %6.2f %% %s\n", i * RPM_BIN, (i + 1) * RPM_BIN - 1,
+                percent(stats.rpm[i], running),
+                std::string(static_cast<size_t>(40 * stats.rpm[i] / peak), '#').c_str());
+    }
+
+    std::printf("\nactivity\n");
+    std::printf("  led on      %6.2f %%\n", percent(stats.ledOn, rows));
+    std::printf("  motor on    %6.2f %%, mean duty %.1f / 63 while on\n",
+            percent(stats.motorOn, rows),
+            stats.motorOn ? static_cast<double>(stats.motorSum) / stats.motorOn : 0.0);
+    std::printf("  horn on     %6.2f %%, %llu notes\n", percent(stats.hornOn, rows),
+            static_cast<unsigned long long>(stats.hornNotes));
+
+    const double hours = static_cast<double>(rows) / telemetry::ROW_RATE_HZ / 3600;
+    std::printf("\ntiming\n");
+    std::printf("  loop cycles min %u, mean %.1f, max %u\n", stats.loopMin,
+            static_cast<double>(stats.loopSum) / rows, stats.loopMax);
+    std::printf("  overruns    %llu (%.2f per hour), %.4f %% of the ticks late\n",
+            static_cast<unsigned long long>(stats.overruns), stats.overruns / hours,
+            percent(stats.overrunRows, rows));
+
+    if (stats.audioSamples) {
+        std::printf("\naudio\n");
+        std::printf("  peak %u, %llu clipped samples (%.4f %%)\n", stats.audioPeak,
+                static_cast<unsigned long long>(stats.audioClipped),
+                percent(stats.audioClipped, stats.audioSamples));
+    }
+
+    return 0;
+}
+
+static void usage(const char *program)
+{
+    std::printf("usage: %s record FILE [--hours H] [--audio] [--seed S]\n", program);
+    std::printf("       %s analyze FILE\n", program);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc >= 3 && !std::strcmp(argv[1], "analyze"))
+        return analyze(argv[2]);
+
+    if (argc >= 3 && !std::strcmp(argv[1], "record")) {
+        double hours = 1.0;
+        bool withAudio = false;
+        uint32_t seed = 1;
+        for (int i = 3; i < argc; ++i) {
+            if (!std::strcmp(argv[i], "--hours") && i + 1 < argc)
+                hours = std::max(0.0, std::atof(argv[++i]));
+            else if (!std::strcmp(argv[i], "--audio"))
+                withAudio = true;
+            else if (!std::strcmp(argv[i], "--seed") && i + 1 < argc)
+                seed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 0));
+            else {
+                usage(argv[0]);
+                return 1;
+            }
+        }
+        return record(argv[2], hours, withAudio, seed);
+    }
+
+    usage(argv[0]);
+    return 1;
+}
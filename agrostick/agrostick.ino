@@ -1,298 +1,958 @@
-#include <EEPROM.h>
-#include <HID.h>
-#include <Mouse.h>
-
-#include <string.h>
-
-#ifndef _USING_HID
-#error "Agrostick require a USB MCU with PluggableHID core enabled."
-#endif
-
-// #define DEBUG_AGROSTICK
-#ifndef DEBUG_AGROSTICK
-constexpr uint8_t SLOWDOWN_FACTOR {1};
-#else
-constexpr uint8_t SLOWDOWN_FACTOR {25};
-#endif
-
-class Agrostick
-{
-public:
-    void begin() {
-        initButton();
-        initOutput();
-
-        initJoystickDescriptor();
-        Mouse.begin();
-
-        m_mode = emulationMode();
-
-#ifdef DEBUG_AGROSTICK
-        Serial.begin(9600);
-#endif
-    }
-
-    void readInputs() {
-        for (uint8_t i = 0; i < AXIS_COUNT; ++i)
-            readAxis(i);
-        for (uint8_t i = 0; i < BUTTON_COUNT; ++i)
-            readButton(i);
-        checkModeSwitch();
-    }
-
-    void writeOutput() {
-        digitalWrite(PIN_JOYSTCK_MODE, m_joystickEmulation ? HIGH : LOW);
-        digitalWrite(PIN_MOUSE_MODE, m_joystickEmulation ? LOW : HIGH);
-    }
-
-    void sendReport() {
-        sendJoystickReport();
-        sendMouseReport();
-        sendSerialDebugInfo();
-    }
-
-    int16_t nextTick() const {
-        return 20 * SLOWDOWN_FACTOR;
-    }
-
-private:
-    // ** Mode switch management (joystick <-> mouse) ** //
-    static constexpr uint8_t SWITCH_MODE_TIMER {100 / SLOWDOWN_FACTOR};
-    static constexpr uint8_t EEPROM_MAGIC_VALUE {0x44};
-
-    enum class Mode {
-        JOYSTICK,
-        MOUSE,
-    };
-    Mode        m_mode;
-    bool        m_joystickEmulation;
-    uint8_t     m_switchModeCount {SWITCH_MODE_TIMER};
-
-    Mode emulationMode() const {
-        return (EEPROM[0] == EEPROM_MAGIC_VALUE) ? Mode::JOYSTICK : Mode::MOUSE;
-    }
-
-    void toggleMode() {
-        m_mode = (m_mode == Mode::MOUSE) ? Mode::JOYSTICK : Mode::MOUSE;
-        EEPROM[0] = (m_mode == Mode::JOYSTICK) ? EEPROM_MAGIC_VALUE : 0x00; 
-    }
-
-    void checkModeSwitch() {
-        if (m_switchModeCount > 0 && m_button[0] && m_button[1] && m_button[2] && m_button[3]) {
-            m_switchModeCount--;
-            if (m_switchModeCount == 0)
-                toggleMode();
-        } else {
-            m_switchModeCount = SWITCH_MODE_TIMER;
-        }
-    }
-
-    // ** Joystick HID descriptor and report management ** //
-    static constexpr uint8_t REPORT_ID {0x03};
-    static constexpr uint8_t HID_REPORT_DESCRIPTOR[] PROGMEM {
-        0x05, 0x01,         // USAGE_PAGE (Generic Desktop)
-        0x09, 0x04,         // USAGE (Joystick: 0x04)
-        0xA1, 0x01,         // COLLECTION (Application)
-        0x85, REPORT_ID,    // REPORT_ID (Default: 0x03)
-        0x05, 0x09,         // USAGE_PAGE (Button)
-        0x19, 0x01,         // USAGE_MINIMUM (Button: 1)
-        0x29, 0x07,         // USAGE_MAXIMUM (Button: 7)
-        0x15, 0x00,         // LOGICAL_MINIMUM (0)
-        0x25, 0x01,         // LOGICAL_MAXIMUM (1)
-        0x75, 0x01,         // REPORT_SIZE (1)
-        0x95, 0x08,         // REPORT_COUNT (Button + Spare: 8)
-        0x55, 0x00,         // UNIT_EXPONENT (0)
-        0x65, 0x00,         // UNIT (None)
-        0x81, 0x02,         // INPUT (Data, Var, Abs)
-        0x05, 0x01,         // USAGE_PAGE (Generic Desktop)
-        0x09, 0x01,         // USAGE (Pointer)
-        0x16, 0x01, 0x80,   // LOGICAL_MINIMUM (-32767)
-        0x26, 0xFF, 0x7F,   // LOGICAL_MAXIMUM (+32767)
-        0x75, 0x10,         // REPORT_SIZE (16)
-        0x95, 0x03,         // REPORT_COUNT (Axes: 3)
-        0xA1, 0x00,         // COLLECTION (Physical)
-        0x09, 0x30,         // USAGE (X)
-        0x09, 0x31,         // USAGE (Y)
-        0x09, 0x32,         // USAGE (Z)
-        0x81, 0x02,         // INPUT (Data, Var, Abs)
-        0xC0,               // END_COLLECTION (Physical)
-        0xC0,               // END_COLLECTION
-    };
-
-    void initJoystickDescriptor() {
-        static HIDSubDescriptor node(HID_REPORT_DESCRIPTOR, sizeof(HID_REPORT_DESCRIPTOR));
-        HID().AppendDescriptor(&node);
-    }
-
-    void sendJoystickReport() {
-        static uint8_t hidReport[7];
-
-        if (m_mode == Mode::JOYSTICK) {
-            uint8_t index {0};
-            uint8_t buttonBitmask {0};
-            for (uint8_t i = 0; i < BUTTON_COUNT; ++i)
-                buttonBitmask |= (m_button[i] << i);
-            hidReport[index++] = buttonBitmask;
-
-            for (uint8_t i = 0; i < AXIS_COUNT; ++i) {
-                hidReport[index++] = static_cast<uint8_t>(m_axis[i]);
-                hidReport[index++] = static_cast<uint8_t>(m_axis[i] >> 8);
-            }
-        } else {
-            memset(hidReport, 0x00, sizeof(hidReport));
-        }
-
-        HID().SendReport(REPORT_ID, hidReport, sizeof(hidReport));
-    }
-
-    // ** Mouse emulation management ** //
-    int8_t virtualMouseMovement(uint8_t index, int8_t range) const {
-        return (m_mode == Mode::MOUSE) ? map(m_axis[index], -32767, 32767, -range, range) : 0;
-    }
-
-    uint8_t virtualMouseButton(uint8_t index) const {
-        return (m_mode == Mode::MOUSE) ? m_button[index] : 0;
-    }
-
-    void sendMouseReport() {
-        Mouse.move(virtualMouseMovement(0, 18), virtualMouseMovement(1, 18),
-                virtualMouseMovement(2, 2));
-
-        constexpr uint8_t MOUSE_BUTTON[3] {MOUSE_MIDDLE, MOUSE_LEFT, MOUSE_RIGHT};
-        for (uint8_t i = 0; i < 3; ++i) {
-            if (virtualMouseButton(i + 4)) {
-                if (!Mouse.isPressed(MOUSE_BUTTON[i]))
-                    Mouse.press(MOUSE_BUTTON[i]);
-            } else {
-                if (Mouse.isPressed(MOUSE_BUTTON[i]))
-                    Mouse.release(MOUSE_BUTTON[i]);
-            }
-        }
-    }
-
-    // ** Analog axes management ** //
-    struct AgrostickAxis {
-        int16_t     minValue;
-        int16_t     maxValue;
-        int16_t     zeroValue;
-        uint8_t     deadBand;
-        bool        reversed;
-        uint8_t     pin;
-    };
-
-    static constexpr uint8_t AXIS_COUNT {3};
-    static constexpr AgrostickAxis AGROSTICK_AXIS[AXIS_COUNT] {
-        {85, 935, 512, 30, false, A0},
-        {85, 935, 515, 30, true, A1},
-        {95, 925, 500, 30, false, A2},
-    };
-
-    int16_t     m_rawAxisAi[AXIS_COUNT] {};
-    int16_t     m_axis[AXIS_COUNT] {};
-
-    void readAxis(uint8_t index) {
-        auto value = analogRead(AGROSTICK_AXIS[index].pin);
-        m_rawAxisAi[index] = value;
-
-        const int16_t zeroValue {AGROSTICK_AXIS[index].zeroValue};
-        const int16_t deadBand {AGROSTICK_AXIS[index].deadBand};
-        const int16_t lowMin {AGROSTICK_AXIS[index].minValue};
-        const int16_t lowMax {zeroValue - deadBand};
-        const int16_t highMin {zeroValue + deadBand};
-        const int16_t highMax {AGROSTICK_AXIS[index].maxValue};
-        value = constrain(value, lowMin, highMax);
-
-        int16_t scaledValue;
-        if (value >= lowMin && value <= lowMax)
-            scaledValue = map(value, lowMin, lowMax, -32767, 0);
-        else if (value >= highMin && value <= highMax)
-            scaledValue = map(value, highMin, highMax, 0, 32767);
-        else
-            scaledValue = 0;
-
-        m_axis[index] = AGROSTICK_AXIS[index].reversed ? -scaledValue : scaledValue;
-    }
-
-    // ** Digital buttons management ** //
-    struct AgrostickButton {
-        bool        reversed;
-        bool        internalPullup;
-        uint8_t     pin;
-    };
-    static constexpr uint8_t BUTTON_COUNT {7};
-    static constexpr AgrostickButton AGROSTICK_BUTTON[BUTTON_COUNT] {
-        {true, true, 2},
-        {true, true, 3},
-        {true, true, 4},
-        {true, true, 5},
-        {false, false, 6},
-        {false, false, 7},
-        {false, false, 8},
-    };
-
-    uint8_t     m_button[BUTTON_COUNT] {};
-    uint8_t     m_oldButton[BUTTON_COUNT] {};
-
-    void initButton() {
-        for (uint8_t i = 0; i < BUTTON_COUNT; ++i)
-            pinMode(AGROSTICK_BUTTON[i].pin,
-                    AGROSTICK_BUTTON[i].internalPullup ? INPUT_PULLUP : INPUT);
-    }
-
-    void readButton(uint8_t index) {
-        auto button = digitalRead(AGROSTICK_BUTTON[index].pin);
-
-        if (AGROSTICK_BUTTON[index].reversed)
-            button ^= 1;
-
-        if (m_oldButton[index] == button)
-            m_button[index] = button;
-        m_oldButton[index] = button;
-    }
-
-    // ** Digital output management ** //
-    static constexpr uint8_t PIN_JOYSTCK_MODE {11};
-    static constexpr uint8_t PIN_MOUSE_MODE {12};
-
-    void initOutput() {
-        pinMode(PIN_JOYSTCK_MODE, OUTPUT);
-        pinMode(PIN_MOUSE_MODE, OUTPUT);
-    }
-
-    // ** Debug ** //
-    void sendSerialDebugInfo() {
-#ifdef DEBUG_AGROSTICK
-        char buffer[50];
-        for (uint8_t i = 0; i < BUTTON_COUNT; ++i) {
-            sprintf(buffer, "B%d: %d/%d", i, m_oldButton[i], m_button[i]);
-            Serial.println(buffer);
-        }
-
-        for (uint8_t i = 0; i < AXIS_COUNT; ++i) {
-            sprintf(buffer, "A%d: %d [raw: %d]", i, m_axis[i], m_rawAxisAi[i]);
-            Serial.println(buffer);
-        }
-#endif
-    }
-};
-
-constexpr uint8_t Agrostick::HID_REPORT_DESCRIPTOR[] PROGMEM;
-constexpr Agrostick::AgrostickAxis Agrostick::AGROSTICK_AXIS[];
-constexpr Agrostick::AgrostickButton Agrostick::AGROSTICK_BUTTON[];
-
-Agrostick agrostick;
-
-void setup() {
-    agrostick.begin();
-}
-
-void loop() {
-    static uint32_t nextTick = 0;
-    if (millis() >= nextTick) {
-        agrostick.readInputs();
-        agrostick.writeOutput();
-        agrostick.sendReport();
-
-        nextTick += agrostick.nextTick();
-    }
-}
+#include <EEPROM.h>
+#include <HID.h>
+
+#include <string.h>
+
+#include <tiny_input.h>
+
+#ifndef _USING_HID
+#error "Agrostick require a USB MCU with PluggableHID core enabled."
+#endif
+
+// #define DEBUG_AGROSTICK
+
+// ** Compile-time helpers ** //
+template <uint8_t... I>
+struct IndexSequence {};
+
+template <uint8_t N, uint8_t... I>
+struct MakeIndexSequence : MakeIndexSequence<N - 1, N - 1, I...> {};
+
+template <uint8_t... I>
+struct MakeIndexSequence<0, I...> {
+    using type = IndexSequence<I...>;
+};
+
+// Call f(0), f(1), ..., f(N - 1) with the loop fully unrolled at compile time
+template <uint8_t N>
+struct Unroll {
+    template <typename F>
+    static inline __attribute__((always_inline)) void apply(F &&f) {
+        Unroll<N - 1>::apply(f);
+        f(N - 1);
+    }
+};
+
+template <>
+struct Unroll<0> {
+    template <typename F>
+    static inline __attribute__((always_inline)) void apply(F &&) {}
+};
+
+// ** Joystick HID descriptor generator ** //
+// The descriptor declares the buttons (padded to a whole number of bytes)
+// followed by the axes as 16-bit values, using the Generic Desktop usages
+// from X (0x30) onward.
+template <uint8_t ReportId, uint8_t Axes, uint8_t Buttons,
+        typename = typename MakeIndexSequence<2 * Axes>::type>
+struct JoystickDescriptor;
+
+template <uint8_t ReportId, uint8_t Axes, uint8_t Buttons, uint8_t... I>
+struct JoystickDescriptor<ReportId, Axes, Buttons, IndexSequence<I...>> {
+    static_assert(Axes > 0 && Axes <= 9, "Axes must use the usages X..Wheel");
+    static_assert(Buttons > 0 && Buttons <= 248, "Too many buttons");
+
+    static constexpr uint8_t BUTTON_BITS {((Buttons + 7) / 8) * 8};
+
+    static constexpr uint8_t axisUsage(uint8_t i) {
+        return (i % 2 == 0) ? 0x09 : 0x30 + i / 2;
+    }
+
+    static constexpr uint8_t DATA[] PROGMEM {
+        0x05, 0x01,         // USAGE_PAGE (Generic Desktop)
+        0x09, 0x04,         // USAGE (Joystick: 0x04)
+        0xA1, 0x01,         // COLLECTION (Application)
+        0x85, ReportId,     // REPORT_ID
+        0x05, 0x09,         // USAGE_PAGE (Button)
+        0x19, 0x01,         // USAGE_MINIMUM (Button: 1)
+        0x29, Buttons,      // USAGE_MAXIMUM (Button: Buttons)
+        0x15, 0x00,         // LOGICAL_MINIMUM (0)
+        0x25, 0x01,         // LOGICAL_MAXIMUM (1)
+        0x75, 0x01,         // REPORT_SIZE (1)
+        0x95, BUTTON_BITS,  // REPORT_COUNT (Button + Spare)
+        0x55, 0x00,         // UNIT_EXPONENT (0)
+        0x65, 0x00,         // UNIT (None)
+        0x81, 0x02,         // INPUT (Data, Var, Abs)
+        0x05, 0x01,         // USAGE_PAGE (Generic Desktop)
+        0x09, 0x01,         // USAGE (Pointer)
+        0x16, 0x01, 0x80,   // LOGICAL_MINIMUM (-32767)
+        0x26, 0xFF, 0x7F,   // LOGICAL_MAXIMUM (+32767)
+        0x75, 0x10,         // REPORT_SIZE (16)
+        0x95, Axes,         // REPORT_COUNT (Axes)
+        0xA1, 0x00,         // COLLECTION (Physical)
+        axisUsage(I)...,    // USAGE (X), USAGE (Y), ...
+        0x81, 0x02,         // INPUT (Data, Var, Abs)
+        0xC0,               // END_COLLECTION (Physical)
+        0xC0,               // END_COLLECTION
+    };
+};
+
+template <uint8_t ReportId, uint8_t Axes, uint8_t Buttons, uint8_t... I>
+constexpr uint8_t JoystickDescriptor<ReportId, Axes, Buttons,
+        IndexSequence<I...>>::DATA[] PROGMEM;
+
+// ** Mouse HID descriptor ** //
+// Relative mouse with 3 buttons and X, Y and wheel movements, matching the
+// boot protocol report layout (buttons, X, Y, wheel) after the report ID.
+template <uint8_t ReportId>
+struct MouseDescriptor {
+    static constexpr uint8_t DATA[] PROGMEM {
+        0x05, 0x01,         // USAGE_PAGE (Generic Desktop)
+        0x09, 0x02,         // USAGE (Mouse)
+        0xA1, 0x01,         // COLLECTION (Application)
+        0x85, ReportId,     // REPORT_ID
+        0x09, 0x01,         // USAGE (Pointer)
+        0xA1, 0x00,         // COLLECTION (Physical)
+        0x05, 0x09,         // USAGE_PAGE (Button)
+        0x19, 0x01,         // USAGE_MINIMUM (Button: 1)
+        0x29, 0x03,         // USAGE_MAXIMUM (Button: 3)
+        0x15, 0x00,         // LOGICAL_MINIMUM (0)
+        0x25, 0x01,         // LOGICAL_MAXIMUM (1)
+        0x95, 0x03,         // REPORT_COUNT (3)
+        0x75, 0x01,         // REPORT_SIZE (1)
+        0x81, 0x02,         // INPUT (Data, Var, Abs)
+        0x95, 0x01,         // REPORT_COUNT (1)
+        0x75, 0x05,         // REPORT_SIZE (5)
+        0x81, 0x03,         // INPUT (Cnst, Var, Abs)
+        0x05, 0x01,         // USAGE_PAGE (Generic Desktop)
+        0x09, 0x30,         // USAGE (X)
+        0x09, 0x31,         // USAGE (Y)
+        0x09, 0x38,         // USAGE (Wheel)
+        0x15, 0x81,         // LOGICAL_MINIMUM (-127)
+        0x25, 0x7F,         // LOGICAL_MAXIMUM (127)
+        0x75, 0x08,         // REPORT_SIZE (8)
+        0x95, 0x03,         // REPORT_COUNT (3)
+        0x81, 0x06,         // INPUT (Data, Var, Rel)
+        0xC0,               // END_COLLECTION (Physical)
+        0xC0,               // END_COLLECTION
+    };
+};
+
+template <uint8_t ReportId>
+constexpr uint8_t MouseDescriptor<ReportId>::DATA[] PROGMEM;
+
+// ** Mouse response curve generator ** //
+// Look-up table for tiny_curve_apply() blending a linear and a quadratic
+// response (Acceleration 0 = linear, 255 = fully quadratic), evaluated at
+// compile time on the TINY_INPUT_CURVE_POINTS magnitudes 0, 2048, ..., 32768.
+template <uint8_t Acceleration,
+        typename = typename MakeIndexSequence<TINY_INPUT_CURVE_POINTS>::type>
+struct MouseCurve;
+
+template <uint8_t Acceleration, uint8_t... I>
+struct MouseCurve<Acceleration, IndexSequence<I...>> {
+    static constexpr int32_t blend(int32_t linear) {
+        return (linear * (256 - Acceleration) +
+                ((linear * linear) >> 15) * Acceleration) >> 8;
+    }
+
+    static constexpr int16_t point(uint8_t i) {
+        return static_cast<int16_t>(blend(i * 2048L) > TINY_INPUT_AXIS_MAX ?
+                TINY_INPUT_AXIS_MAX : blend(i * 2048L));
+    }
+
+    static constexpr int16_t DATA[] PROGMEM {point(I)...};
+};
+
+template <uint8_t Acceleration, uint8_t... I>
+constexpr int16_t MouseCurve<Acceleration, IndexSequence<I...>>::DATA[] PROGMEM;
+
+// ** Tick timer ** //
+// Timer3 runs in CTC mode and raises a compare match interrupt once per tick.
+// The ISR only counts ticks, so the tick period is locked to the MCU clock
+// and never drifts, whatever the time spent in loop().  All the counters use
+// modular arithmetic, therefore they are not affected by wraparounds.
+// Lateness is the time elapsed from the tick to the moment loop() serves it.
+// @note Timer3 is also used by tone(), which is not available anymore.
+class TickTimer
+{
+public:
+    static volatile uint8_t s_tickCount;
+
+    void begin(uint16_t periodMs) {
+        m_period = static_cast<uint16_t>(TIMER_CLOCK_KHZ * periodMs);
+
+        const uint8_t sreg {SREG};
+        cli();
+        TCCR3A = 0;
+        TCCR3B = _BV(WGM32) |           // Clear Timer on Compare mode
+                _BV(CS31) | _BV(CS30);  // set Clock Prescaler to 64
+        OCR3A = m_period - 1;
+        TCNT3 = 0;
+        TIFR3 = _BV(OCF3A);
+        TIMSK3 = _BV(OCIE3A);           // enable Compare Match interrupt
+        m_servedCount = s_tickCount;
+        SREG = sreg;
+    }
+
+    bool expired() {
+        const uint8_t sreg {SREG};
+        cli();
+        const uint8_t tickCount {s_tickCount};
+        uint32_t elapsed {TCNT3};
+        if (TIFR3 & _BV(OCF3A))
+            elapsed += m_period;        // compare match not yet counted
+        SREG = sreg;
+
+        if (tickCount == m_servedCount)
+            return false;
+
+        const uint8_t missed = tickCount - m_servedCount - 1;
+        m_servedCount = tickCount;
+        m_missedTicks += missed;
+
+        elapsed += static_cast<uint32_t>(missed) * m_period;
+        m_lateness = elapsed * 1000 / TIMER_CLOCK_KHZ;
+        if (m_lateness > m_maxLateness)
+            m_maxLateness = m_lateness;
+        return true;
+    }
+
+    uint32_t lateness() const { return m_lateness; }
+    uint32_t maxLateness() const { return m_maxLateness; }
+    uint16_t missedTicks() const { return m_missedTicks; }
+
+private:
+    static constexpr uint16_t TIMER_CLOCK_KHZ {F_CPU / 64 / 1000};
+
+    uint16_t    m_period {0};
+    uint8_t     m_servedCount {0};
+    uint16_t    m_missedTicks {0};
+    uint32_t    m_lateness {0};
+    uint32_t    m_maxLateness {0};
+};
+
+volatile uint8_t TickTimer::s_tickCount {0};
+
+ISR(TIMER3_COMPA_vect)
+{
+    ++TickTimer::s_tickCount;
+}
+
+// ** Background ADC sampling ** //
+// The ADC converts the analog inputs continuously in the background: the
+// conversion complete interrupt stores the reading, moves the scan to the
+// next slot and starts its conversion, so loop() never waits for the ADC.
+// Every slot is averaged over 2^OVERSAMPLING_SHIFT readings.  With the ADC
+// clock set by the Arduino core (125 kHz) a conversion takes CONVERSION_US,
+// so a full average of 3 slots is refreshed every 5 ms.
+//
+// Analog multiplexers (CD4051 or similar) extend the inputs: each mux has its
+// common pin wired to an analog pin and its select inputs (A, B, C) wired to
+// three digital pins shared by all the muxes.  A slot on a mux is given by
+// the analog pin and the mux channel (0-7), a slot wired directly to an
+// analog pin uses NO_MUX.
+// The scan order is built once in begin(): the mux slots are grouped by
+// channel, so that the select lines change once per group, and the direct
+// slots are interleaved between the groups.  The select lines are switched
+// right after the conversion of a direct slot starts, so the mux settles
+// while another input is converted.  When there are more groups than direct
+// slots, the remaining switches are done right before the conversion, and
+// the mux settles during the sample and hold phase (1.5 ADC clocks, 12 us).
+// Either way no delay nor dummy conversion is ever added: every slot costs a
+// single conversion and the scan time grows only with the number of slots.
+// @note analogRead() must not be used while the background sampling runs.
+class BackgroundAdc
+{
+public:
+    static constexpr uint8_t MAX_SLOTS {16};
+    static constexpr uint8_t OVERSAMPLING_SHIFT {4};
+    static constexpr uint8_t CONVERSION_US {104};
+    static constexpr uint8_t NO_MUX {0xFF};
+    static constexpr uint8_t MUX_SELECT_LINES {3};
+    static constexpr uint8_t MUX_CHANNELS {1 << MUX_SELECT_LINES};
+
+    // Start the background sampling, or return false without starting it if
+    // a mux channel is neither NO_MUX nor 0 to MUX_CHANNELS - 1
+    bool begin(const uint8_t *pins, const uint8_t *muxChannels, uint8_t count,
+            const uint8_t *selectPins) {
+        for (uint8_t i = 0; i < count; ++i) {
+            if (muxChannels[i] != NO_MUX && muxChannels[i] >= MUX_CHANNELS)
+                return false;
+        }
+
+        const uint8_t sreg {SREG};
+        cli();
+        bool muxUsed {false};
+        for (uint8_t i = 0; i < count; ++i) {
+            const uint8_t pin = pins[i] >= A0 ? pins[i] - A0 : pins[i];
+            const uint8_t channel = analogPinToChannel(pin);
+            s_value[i] = 0;
+            s_oversampler[i] = TinyOversampler {0, 0};
+            muxUsed |= (muxChannels[i] != NO_MUX);
+
+            // disable the digital input buffer of the pin
+            if (channel < 8)
+                DIDR0 |= _BV(channel);
+            else
+                DIDR2 |= _BV(channel - 8);
+        }
+
+        schedule(pins, muxChannels, count);
+        if (muxUsed) {
+            for (uint8_t i = 0; i < MUX_SELECT_LINES; ++i) {
+                pinMode(selectPins[i], OUTPUT);
+                s_selectPort[i] = portOutputRegister(digitalPinToPort(selectPins[i]));
+                s_selectMask[i] = digitalPinToBitMask(selectPins[i]);
+            }
+            // the first slot is on a mux whenever a mux is used
+            writeSelect(muxChannels[s_slot[0]]);
+        }
+
+        tiny_adc_scan_begin(&s_scan, count);
+        startConversion(0);
+        SREG = sreg;
+        return true;
+    }
+
+    // Latest average of the given slot (0 until the first one is complete)
+    int16_t read(uint8_t slot) const {
+        const uint8_t sreg {SREG};
+        cli();
+        const uint16_t value {s_value[slot]};
+        SREG = sreg;
+        return static_cast<int16_t>(value);
+    }
+
+    // Called by the ADC conversion complete interrupt
+    static void conversionComplete() {
+        const uint16_t reading {ADC};
+        const uint8_t slot {s_slot[s_scan.slot]};
+
+        uint16_t average;
+        if (tiny_oversampler_add(&s_oversampler[slot], reading,
+                OVERSAMPLING_SHIFT, &average))
+            s_value[slot] = average;
+
+        tiny_adc_scan_advance(&s_scan);
+        startConversion(s_scan.slot);
+    }
+
+private:
+    // Select lines update attached to a scan position (mux channel in the
+    // low bits)
+    static constexpr uint8_t SELECT_NONE {0x00};
+    static constexpr uint8_t SELECT_BEFORE {0x10};
+    static constexpr uint8_t SELECT_AFTER {0x20};
+
+    // Scan order: ADC channel, slot and select lines update of each position
+    static uint8_t          s_channel[MAX_SLOTS];
+    static uint8_t          s_slot[MAX_SLOTS];
+    static uint8_t          s_select[MAX_SLOTS];
+    static volatile uint8_t *s_selectPort[MUX_SELECT_LINES];
+    static uint8_t          s_selectMask[MUX_SELECT_LINES];
+    static volatile uint16_t s_value[MAX_SLOTS];
+    static TinyOversampler  s_oversampler[MAX_SLOTS];
+    static TinyAdcScan      s_scan;
+
+    static void schedule(const uint8_t *pins, const uint8_t *muxChannels,
+            uint8_t count) {
+        uint8_t direct[MAX_SLOTS];
+        uint8_t directCount {0};
+        for (uint8_t i = 0; i < count; ++i) {
+            if (muxChannels[i] == NO_MUX)
+                direct[directCount++] = i;
+        }
+
+        // mux groups by channel, each followed by a direct slot if any left
+        uint8_t position {0};
+        uint8_t nextDirect {0};
+        for (uint8_t channel = 0; channel < MUX_CHANNELS; ++channel) {
+            bool group {false};
+            for (uint8_t i = 0; i < count; ++i) {
+                if (muxChannels[i] == channel) {
+                    s_slot[position++] = i;
+                    group = true;
+                }
+            }
+            if (group && nextDirect < directCount)
+                s_slot[position++] = direct[nextDirect++];
+        }
+        while (nextDirect < directCount)
+            s_slot[position++] = direct[nextDirect++];
+
+        // switch the select lines for each mux slot that needs another channel
+        // than the previous position (the scan is cyclic)
+        for (position = 0; position < count; ++position) {
+            const uint8_t slot {s_slot[position]};
+            const uint8_t pin = pins[slot] >= A0 ? pins[slot] - A0 : pins[slot];
+            s_channel[position] = analogPinToChannel(pin);
+            s_select[position] = SELECT_NONE;
+        }
+        for (position = 0; position < count; ++position) {
+            const uint8_t muxChannel {muxChannels[s_slot[position]]};
+            if (muxChannel == NO_MUX)
+                continue;
+
+            const uint8_t previous = (position > 0 ? position : count) - 1;
+            const uint8_t previousChannel {muxChannels[s_slot[previous]]};
+            if (previousChannel == NO_MUX)
+                s_select[previous] = SELECT_AFTER | muxChannel;
+            else if (previousChannel != muxChannel)
+                s_select[position] = SELECT_BEFORE | muxChannel;
+        }
+    }
+
+    static void writeSelect(uint8_t muxChannel) {
+        for (uint8_t i = 0; i < MUX_SELECT_LINES; ++i) {
+            if (muxChannel & (1 << i))
+                *s_selectPort[i] |= s_selectMask[i];
+            else
+                *s_selectPort[i] &= static_cast<uint8_t>(~s_selectMask[i]);
+        }
+    }
+
+    static void startConversion(uint8_t position) {
+        const uint8_t channel {s_channel[position]};
+        const uint8_t select {s_select[position]};
+        if (select & SELECT_BEFORE)
+            writeSelect(select);
+        ADCSRB = (channel & 0x08) ? _BV(MUX5) : 0;
+        ADMUX = _BV(REFS0) |                // AVcc reference
+                (channel & 0x07);
+        ADCSRA = _BV(ADEN) | _BV(ADIE) |    // enable ADC and its interrupt
+                _BV(ADSC) |                 // start the conversion
+                _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);   // prescaler 128
+        if (select & SELECT_AFTER)
+            writeSelect(select);
+    }
+};
+
+uint8_t BackgroundAdc::s_channel[BackgroundAdc::MAX_SLOTS] {};
+uint8_t BackgroundAdc::s_slot[BackgroundAdc::MAX_SLOTS] {};
+uint8_t BackgroundAdc::s_select[BackgroundAdc::MAX_SLOTS] {};
+volatile uint8_t *BackgroundAdc::s_selectPort[BackgroundAdc::MUX_SELECT_LINES] {};
+uint8_t BackgroundAdc::s_selectMask[BackgroundAdc::MUX_SELECT_LINES] {};
+volatile uint16_t BackgroundAdc::s_value[BackgroundAdc::MAX_SLOTS] {};
+TinyOversampler BackgroundAdc::s_oversampler[BackgroundAdc::MAX_SLOTS] {};
+TinyAdcScan BackgroundAdc::s_scan {};
+
+ISR(ADC_vect)
+{
+    BackgroundAdc::conversionComplete();
+}
+
+// ** Agrostick configuration ** //
+struct AgrostickAxis {
+    TinyAxisConfig  calibration;
+    uint8_t         pin;
+    uint8_t         muxChannel; // 0-7, or BackgroundAdc::NO_MUX if wired to the pin
+};
+
+struct AgrostickButton {
+    bool        reversed;
+    bool        internalPullup;
+    uint8_t     pin;
+};
+
+struct AgrostickMouseAxis {
+    uint16_t        maxSpeed;
+    const int16_t   *curve;     // see tiny_curve_apply(), nullptr = linear
+};
+
+template <uint8_t Axes, uint8_t Buttons>
+class Agrostick
+{
+public:
+    static constexpr uint8_t AXIS_COUNT {Axes};
+    static constexpr uint8_t BUTTON_COUNT {Buttons};
+
+    // Pin configuration, to be provided for each control panel variant
+    static const AgrostickAxis AGROSTICK_AXIS[AXIS_COUNT];
+    static const uint8_t AGROSTICK_MUX_SELECT[BackgroundAdc::MUX_SELECT_LINES];
+    static const AgrostickButton AGROSTICK_BUTTON[BUTTON_COUNT];
+
+    void begin() {
+        initAxis();
+        initButton();
+        initOutput();
+
+        initHidDescriptors();
+
+        m_mode = emulationMode();
+        m_reportedMode = m_mode;
+
+        m_tickTimer.begin(TICK_PERIOD_MS);
+
+#ifdef DEBUG_AGROSTICK
+        Serial.begin(115200);
+#endif
+    }
+
+    void readInputs() {
+        m_tickStart = micros();
+        for (uint8_t i = 0; i < AXIS_COUNT; ++i)
+            readAxis(i);
+        checkModeSwitch();
+    }
+
+    void scanButtons() {
+        const uint32_t now {static_cast<uint32_t>(micros())};
+        if (now - m_lastButtonScan < BUTTON_SCAN_PERIOD_US)
+            return;
+        m_lastButtonScan = now;
+
+        for (uint8_t i = 0; i < BUTTON_COUNT; ++i)
+            debounceButton(i, now);
+    }
+
+    void writeOutput() {
+        digitalWrite(PIN_JOYSTCK_MODE, m_mode == Mode::JOYSTICK ? HIGH : LOW);
+        digitalWrite(PIN_MOUSE_MODE, m_mode == Mode::JOYSTICK ? LOW : HIGH);
+    }
+
+    void sendReport() {
+        sendHidReport();
+        recordReportLatency();
+        m_loopTime = micros() - m_tickStart;
+        if (m_loopTime > m_maxLoopTime)
+            m_maxLoopTime = m_loopTime;
+        sendSerialDebugInfo();
+    }
+
+    bool tickExpired() {
+        return m_tickTimer.expired();
+    }
+
+private:
+    static constexpr uint16_t TICK_PERIOD_MS {20};
+    static_assert(TICK_PERIOD_MS * (F_CPU / 64 / 1000) <= UINT16_MAX,
+            "Tick period too long for Timer3");
+
+    TickTimer   m_tickTimer;
+    uint32_t    m_tickStart {0};
+    uint32_t    m_loopTime {0};
+    uint32_t    m_maxLoopTime {0};
+
+    // ** Mode switch management (joystick <-> mouse) ** //
+    static_assert(BUTTON_COUNT >= 4, "Mode switch requires buttons 0 to 3");
+    static constexpr uint8_t SWITCH_MODE_TIMER {100};
+    static constexpr uint8_t EEPROM_MAGIC_VALUE {0x44};
+
+    enum class Mode {
+        JOYSTICK,
+        MOUSE,
+    };
+    Mode        m_mode;
+    uint8_t     m_switchModeCount {SWITCH_MODE_TIMER};
+
+    Mode emulationMode() const {
+        return (EEPROM[0] == EEPROM_MAGIC_VALUE) ? Mode::JOYSTICK : Mode::MOUSE;
+    }
+
+    void toggleMode() {
+        m_mode = (m_mode == Mode::MOUSE) ? Mode::JOYSTICK : Mode::MOUSE;
+        EEPROM[0] = (m_mode == Mode::JOYSTICK) ? EEPROM_MAGIC_VALUE : 0x00; 
+    }
+
+    void checkModeSwitch() {
+        if (m_switchModeCount > 0 && button(0) && button(1) && button(2) && button(3)) {
+            m_switchModeCount--;
+            if (m_switchModeCount == 0)
+                toggleMode();
+        } else {
+            m_switchModeCount = SWITCH_MODE_TIMER;
+        }
+    }
+
+    // ** HID descriptors and report management ** //
+    // The device exposes a joystick and a mouse, each with its own report ID,
+    // but only the report of the active mode is built and sent at every tick,
+    // in a single transfer.  When the mode changes, a neutral report (axes
+    // centered, no movement, buttons released) is sent once for the previous
+    // mode, so that the host does not keep stale buttons pressed.
+    static constexpr uint8_t JOYSTICK_REPORT_ID {0x03};
+    static constexpr uint8_t MOUSE_REPORT_ID {0x04};
+    static constexpr uint8_t BUTTON_BYTES {(BUTTON_COUNT + 7) / 8};
+    static constexpr uint8_t JOYSTICK_REPORT_SIZE {BUTTON_BYTES + 2 * AXIS_COUNT};
+    static constexpr uint8_t MOUSE_REPORT_SIZE {4};
+    static constexpr uint8_t REPORT_SIZE {JOYSTICK_REPORT_SIZE > MOUSE_REPORT_SIZE ?
+            JOYSTICK_REPORT_SIZE : MOUSE_REPORT_SIZE};
+
+    using JoystickHid = JoystickDescriptor<JOYSTICK_REPORT_ID, AXIS_COUNT, BUTTON_COUNT>;
+    using MouseHid = MouseDescriptor<MOUSE_REPORT_ID>;
+
+    Mode        m_reportedMode;
+    uint8_t     m_report[REPORT_SIZE] {};
+
+    void initHidDescriptors() {
+        static HIDSubDescriptor joystickNode(JoystickHid::DATA, sizeof(JoystickHid::DATA));
+        static HIDSubDescriptor mouseNode(MouseHid::DATA, sizeof(MouseHid::DATA));
+        HID().AppendDescriptor(&joystickNode);
+        HID().AppendDescriptor(&mouseNode);
+    }
+
+    void sendHidReport() {
+        if (m_mode != m_reportedMode) {
+            memset(m_report, 0x00, sizeof(m_report));
+            sendModeReport(m_reportedMode);
+            resetMouse();
+            m_reportedMode = m_mode;
+        }
+
+        if (m_mode == Mode::JOYSTICK)
+            buildJoystickReport();
+        else
+            buildMouseReport();
+        sendModeReport(m_mode);
+    }
+
+    void sendModeReport(Mode mode) {
+        if (mode == Mode::JOYSTICK)
+            HID().SendReport(JOYSTICK_REPORT_ID, m_report, JOYSTICK_REPORT_SIZE);
+        else
+            HID().SendReport(MOUSE_REPORT_ID, m_report, MOUSE_REPORT_SIZE);
+    }
+
+    void buildJoystickReport() {
+        memset(m_report, 0x00, BUTTON_BYTES);
+        Unroll<BUTTON_COUNT>::apply([this](uint8_t i) {
+            m_report[i / 8] |= (button(i) << (i % 8));
+        });
+
+        Unroll<AXIS_COUNT>::apply([this](uint8_t i) {
+            m_report[BUTTON_BYTES + 2 * i] = static_cast<uint8_t>(m_axis[i]);
+            m_report[BUTTON_BYTES + 2 * i + 1] = static_cast<uint8_t>(m_axis[i] >> 8);
+        });
+    }
+
+    // ** Mouse emulation management ** //
+    // The stick deflection is shaped by a response curve (see MouseCurve) and
+    // scaled to a speed expressed in counts per second at full deflection.
+    // Movements are accumulated with MOUSE_FRACTION_BITS of sub-count
+    // precision, so slow motions are not lost and the speed does not depend
+    // on the report rate.
+    static constexpr uint8_t MOUSE_AXIS_COUNT {AXIS_COUNT < 3 ? AXIS_COUNT : 3};
+    static constexpr AgrostickMouseAxis AGROSTICK_MOUSE_AXIS[3] {
+        {900, MouseCurve<128>::DATA},
+        {900, MouseCurve<128>::DATA},
+        {100, nullptr},
+    };
+    static constexpr uint8_t MOUSE_FRACTION_BITS {8};
+
+    int32_t     m_mouseAccumulator[MOUSE_AXIS_COUNT] {};
+
+    static constexpr int32_t mouseStep(uint8_t index) {
+        return static_cast<int32_t>(AGROSTICK_MOUSE_AXIS[index].maxSpeed) *
+                TICK_PERIOD_MS * (1 << MOUSE_FRACTION_BITS) / 1000;
+    }
+
+    void resetMouse() {
+        for (uint8_t i = 0; i < MOUSE_AXIS_COUNT; ++i)
+            m_mouseAccumulator[i] = 0;
+    }
+
+    int8_t virtualMouseMovement(uint8_t index) {
+        if (index >= MOUSE_AXIS_COUNT)
+            return 0;
+
+        if (m_axis[index] == 0) {
+            m_mouseAccumulator[index] = 0;
+            return 0;
+        }
+
+        const int16_t curved {tiny_curve_apply(AGROSTICK_MOUSE_AXIS[index].curve,
+                m_axis[index])};
+        m_mouseAccumulator[index] += (static_cast<int32_t>(curved) *
+                mouseStep(index)) >> 15;
+
+        int32_t movement {m_mouseAccumulator[index] >> MOUSE_FRACTION_BITS};
+        movement = constrain(movement, -127, 127);
+        m_mouseAccumulator[index] -= movement * (1 << MOUSE_FRACTION_BITS);
+        return static_cast<int8_t>(movement);
+    }
+
+    uint8_t virtualMouseButton(uint8_t index) const {
+        return index < BUTTON_COUNT ? button(index) : 0;
+    }
+
+    // Buttons 4, 5 and 6 are the middle, left and right mouse buttons
+    void buildMouseReport() {
+        static constexpr uint8_t MOUSE_LEFT {0x01};
+        static constexpr uint8_t MOUSE_RIGHT {0x02};
+        static constexpr uint8_t MOUSE_MIDDLE {0x04};
+
+        m_report[0] = (virtualMouseButton(4) ? MOUSE_MIDDLE : 0) |
+                (virtualMouseButton(5) ? MOUSE_LEFT : 0) |
+                (virtualMouseButton(6) ? MOUSE_RIGHT : 0);
+        m_report[1] = static_cast<uint8_t>(virtualMouseMovement(0));
+        m_report[2] = static_cast<uint8_t>(virtualMouseMovement(1));
+        m_report[3] = static_cast<uint8_t>(virtualMouseMovement(2));
+    }
+
+    // ** Analog axes management ** //
+    // The axes are sampled in the background (see BackgroundAdc), readAxis()
+    // only scales the latest average.  Each axis is wired to an analog pin,
+    // directly or through a mux channel, and a full round of averages must
+    // be refreshed within a tick.  With an invalid mux channel the sampling
+    // is not started and all the axes stay centered.
+    static_assert(AXIS_COUNT <= BackgroundAdc::MAX_SLOTS, "Too many axes");
+    static_assert(static_cast<uint32_t>(AXIS_COUNT) *
+            (1 << BackgroundAdc::OVERSAMPLING_SHIFT) *
+            BackgroundAdc::CONVERSION_US <= TICK_PERIOD_MS * 1000UL,
+            "Background ADC round longer than a tick");
+
+    BackgroundAdc m_adc;
+    bool        m_adcRunning {false};
+    int16_t     m_rawAxisAi[AXIS_COUNT] {};
+    int16_t     m_axis[AXIS_COUNT] {};
+
+    void initAxis() {
+        uint8_t pins[AXIS_COUNT];
+        uint8_t muxChannels[AXIS_COUNT];
+        for (uint8_t i = 0; i < AXIS_COUNT; ++i) {
+            pins[i] = AGROSTICK_AXIS[i].pin;
+            muxChannels[i] = AGROSTICK_AXIS[i].muxChannel;
+        }
+        m_adcRunning = m_adc.begin(pins, muxChannels, AXIS_COUNT,
+                AGROSTICK_MUX_SELECT);
+    }
+
+    void readAxis(uint8_t index) {
+        if (!m_adcRunning)
+            return;
+
+        const int16_t value {m_adc.read(index)};
+        m_rawAxisAi[index] = value;
+        m_axis[index] = tiny_axis_scale(&AGROSTICK_AXIS[index].calibration, value);
+    }
+
+    // ** Digital buttons management ** //
+    // Buttons are sampled every BUTTON_SCAN_PERIOD_US by scanButtons() and
+    // debounced with an integrator (see tiny_debounce_update()): every sample
+    // moves the integrator one step towards the raw level, saturating at
+    // DEBOUNCE_INTEGRATOR_MAX.  The button is reported as pressed when the
+    // integrator reaches DEBOUNCE_PRESS_THRESHOLD and as released when it
+    // falls back to DEBOUNCE_RELEASE_THRESHOLD.
+    static constexpr uint16_t BUTTON_SCAN_PERIOD_US {500};
+    static constexpr uint8_t DEBOUNCE_INTEGRATOR_MAX {8};
+    static constexpr uint8_t DEBOUNCE_PRESS_THRESHOLD {4};
+    static constexpr uint8_t DEBOUNCE_RELEASE_THRESHOLD {0};
+    static_assert(DEBOUNCE_RELEASE_THRESHOLD < DEBOUNCE_PRESS_THRESHOLD &&
+            DEBOUNCE_PRESS_THRESHOLD <= DEBOUNCE_INTEGRATOR_MAX,
+            "Invalid debounce thresholds");
+
+    TinyDebounce m_debounce[BUTTON_COUNT] {};
+    uint32_t    m_lastButtonScan {0};
+
+    uint8_t button(uint8_t index) const {
+        return m_debounce[index].level;
+    }
+
+    void initButton() {
+        for (uint8_t i = 0; i < BUTTON_COUNT; ++i)
+            pinMode(AGROSTICK_BUTTON[i].pin,
+                    AGROSTICK_BUTTON[i].internalPullup ? INPUT_PULLUP : INPUT);
+    }
+
+    void debounceButton(uint8_t index, uint32_t now) {
+        static constexpr TinyDebounceConfig DEBOUNCE {DEBOUNCE_INTEGRATOR_MAX,
+                DEBOUNCE_PRESS_THRESHOLD, DEBOUNCE_RELEASE_THRESHOLD};
+
+        auto level = digitalRead(AGROSTICK_BUTTON[index].pin);
+
+        if (AGROSTICK_BUTTON[index].reversed)
+            level ^= 1;
+
+#ifdef AGROSTICK_LATENCY_STATS
+        if (level && m_debounce[index].integrator == 0)
+            m_pressStart[index] = now;
+#endif
+        const uint8_t event {tiny_debounce_update(&m_debounce[index], &DEBOUNCE, level)};
+#ifdef AGROSTICK_LATENCY_STATS
+        if (event == TINY_INPUT_EVENT_PRESS)
+            recordLatency(m_latency.debounce, now - m_pressStart[index]);
+#endif
+        (void)event;
+        (void)now;
+    }
+
+    // ** Press latency instrumentation ** //
+    // With AGROSTICK_LATENCY_STATS the time elapsed from the first sample of
+    // a press to its debounced detection, and to the first report carrying
+    // it, is measured in microseconds.
+#ifdef AGROSTICK_LATENCY_STATS
+    struct LatencyStat {
+        uint32_t    last;
+        uint32_t    max;
+    };
+    struct {
+        LatencyStat debounce;
+        LatencyStat report;
+    } m_latency {};
+
+    uint32_t    m_pressStart[BUTTON_COUNT] {};
+    uint8_t     m_reportedButton[BUTTON_COUNT] {};
+
+    static void recordLatency(LatencyStat &stat, uint32_t latency) {
+        stat.last = latency;
+        if (latency > stat.max)
+            stat.max = latency;
+    }
+#endif
+
+    void recordReportLatency() {
+#ifdef AGROSTICK_LATENCY_STATS
+        const uint32_t now {static_cast<uint32_t>(micros())};
+        for (uint8_t i = 0; i < BUTTON_COUNT; ++i) {
+            if (button(i) && !m_reportedButton[i])
+                recordLatency(m_latency.report, now - m_pressStart[i]);
+            m_reportedButton[i] = button(i);
+        }
+#endif
+    }
+
+    // ** Digital output management ** //
+    static constexpr uint8_t PIN_JOYSTCK_MODE {11};
+    static constexpr uint8_t PIN_MOUSE_MODE {12};
+
+    void initOutput() {
+        pinMode(PIN_JOYSTCK_MODE, OUTPUT);
+        pinMode(PIN_MOUSE_MODE, OUTPUT);
+    }
+
+    // ** Debug ** //
+    // With DEBUG_AGROSTICK a binary telemetry frame is written to the serial
+    // port at every tick with a single write (decoded on the host by
+    // tools/agrostick_telemetry.py).  All the multi-byte fields are little
+    // endian:
+    //   0xA5 0x5A           frame sync
+    //   length              payload length
+    //   payload             see below
+    //   checksum            two's complement of the sum of the payload bytes
+    // The payload is made of:
+    //   flags               bit 0: latency statistics are present
+    //   axes, buttons       axis and button count
+    //   sequence            frame counter (gaps mean dropped frames)
+    //   loopTime            uint16 time spent processing the tick [us]
+    //   maxLoopTime         uint16 maximum loopTime [us]
+    //   lateness            uint16 delay from the tick to its processing [us]
+    //   maxLateness         uint16 maximum lateness [us]
+    //   missedTicks         uint16 ticks not served in time
+    //   buttonBitmask       debounced buttons, BUTTON_BYTES bytes
+    //   rawAxis             int16 raw ADC value for every axis
+    //   axis                int16 scaled value for every axis
+    //   latency             uint16 last/max debounce and last/max report
+    //                       latency [us] (only with AGROSTICK_LATENCY_STATS)
+    static constexpr uint8_t TELEMETRY_SYNC[2] {0xA5, 0x5A};
+#ifdef AGROSTICK_LATENCY_STATS
+    static constexpr uint8_t TELEMETRY_FLAGS {0x01};
+    static constexpr uint8_t TELEMETRY_LATENCY_SIZE {4 * 2};
+#else
+    static constexpr uint8_t TELEMETRY_FLAGS {0x00};
+    static constexpr uint8_t TELEMETRY_LATENCY_SIZE {0};
+#endif
+    static constexpr uint8_t TELEMETRY_PAYLOAD_SIZE {4 + 10 + BUTTON_BYTES +
+            4 * AXIS_COUNT + TELEMETRY_LATENCY_SIZE};
+    static constexpr uint8_t TELEMETRY_FRAME_SIZE {TELEMETRY_PAYLOAD_SIZE + 4};
+
+    uint8_t     m_telemetrySequence {0};
+
+    static uint8_t *packUint16(uint8_t *buffer, uint16_t value) {
+        *buffer++ = static_cast<uint8_t>(value);
+        *buffer++ = static_cast<uint8_t>(value >> 8);
+        return buffer;
+    }
+
+    static uint16_t saturateUint16(uint32_t value) {
+        return value > UINT16_MAX ? UINT16_MAX : static_cast<uint16_t>(value);
+    }
+
+    void sendSerialDebugInfo() {
+#ifdef DEBUG_AGROSTICK
+        static uint8_t frame[TELEMETRY_FRAME_SIZE];
+        uint8_t *payload {frame + 3};
+        uint8_t *buffer {payload};
+
+        frame[0] = TELEMETRY_SYNC[0];
+        frame[1] = TELEMETRY_SYNC[1];
+        frame[2] = TELEMETRY_PAYLOAD_SIZE;
+
+        *buffer++ = TELEMETRY_FLAGS;
+        *buffer++ = AXIS_COUNT;
+        *buffer++ = BUTTON_COUNT;
+        *buffer++ = m_telemetrySequence++;
+        buffer = packUint16(buffer, saturateUint16(m_loopTime));
+        buffer = packUint16(buffer, saturateUint16(m_maxLoopTime));
+        buffer = packUint16(buffer, saturateUint16(m_tickTimer.lateness()));
+        buffer = packUint16(buffer, saturateUint16(m_tickTimer.maxLateness()));
+        buffer = packUint16(buffer, m_tickTimer.missedTicks());
+
+        memset(buffer, 0x00, BUTTON_BYTES);
+        Unroll<BUTTON_COUNT>::apply([this, buffer](uint8_t i) {
+            buffer[i / 8] |= (button(i) << (i % 8));
+        });
+        buffer += BUTTON_BYTES;
+
+        for (uint8_t i = 0; i < AXIS_COUNT; ++i)
+            buffer = packUint16(buffer, m_rawAxisAi[i]);
+        for (uint8_t i = 0; i < AXIS_COUNT; ++i)
+            buffer = packUint16(buffer, m_axis[i]);
+
+#ifdef AGROSTICK_LATENCY_STATS
+        buffer = packUint16(buffer, saturateUint16(m_latency.debounce.last));
+        buffer = packUint16(buffer, saturateUint16(m_latency.debounce.max));
+        buffer = packUint16(buffer, saturateUint16(m_latency.report.last));
+        buffer = packUint16(buffer, saturateUint16(m_latency.report.max));
+#endif
+
+        uint8_t checksum {0};
+        for (uint8_t i = 0; i < TELEMETRY_PAYLOAD_SIZE; ++i)
+            checksum += payload[i];
+        *buffer = -checksum;
+
+        // Never stall the report loop: drop the frame if the host is not
+        // draining the serial port fast enough (the gap shows in sequence)
+        if (Serial.availableForWrite() >= TELEMETRY_FRAME_SIZE)
+            Serial.write(frame, TELEMETRY_FRAME_SIZE);
+#endif
+    }
+};
+
+template <uint8_t Axes, uint8_t Buttons>
+constexpr AgrostickMouseAxis Agrostick<Axes, Buttons>::AGROSTICK_MOUSE_AXIS[];
+template <uint8_t Axes, uint8_t Buttons>
+constexpr uint8_t Agrostick<Axes, Buttons>::TELEMETRY_SYNC[];
+
+// ** Control panel variant: 3 axes and 7 buttons ** //
+using AgrostickPanel = Agrostick<3, 7>;
+
+template <>
+const AgrostickAxis AgrostickPanel::AGROSTICK_AXIS[AgrostickPanel::AXIS_COUNT] {
+    {{85, 935, 512, 30, false}, A0, BackgroundAdc::NO_MUX},
+    {{85, 935, 515, 30, true}, A1, BackgroundAdc::NO_MUX},
+    {{95, 925, 500, 30, false}, A2, BackgroundAdc::NO_MUX},
+};
+
+// Select lines (A, B, C) of the analog muxes, unused without mux axes
+template <>
+const uint8_t AgrostickPanel::AGROSTICK_MUX_SELECT[BackgroundAdc::MUX_SELECT_LINES] {
+    9, 10, 13,
+};
+
+template <>
+const AgrostickButton AgrostickPanel::AGROSTICK_BUTTON[AgrostickPanel::BUTTON_COUNT] {
+    {true, true, 2},
+    {true, true, 3},
+    {true, true, 4},
+    {true, true, 5},
+    {false, false, 6},
+    {false, false, 7},
+    {false, false, 8},
+};
+
+AgrostickPanel agrostick;
+
+void setup() {
+    agrostick.begin();
+}
+
+void loop() {
+    agrostick.scanButtons();
+
+    if (agrostick.tickExpired()) {
+        agrostick.readInputs();
+        agrostick.writeOutput();
+        agrostick.sendReport();
+    }
+}
@@ -0,0 +1,124 @@
+# !/usr/bin/env python
+# -*- coding: utf-8 -*-
+import os.path
+import struct
+import sys
+
+FRAME_SYNC = b'\xa5\x5a'
+FLAG_LATENCY = 0x01
+
+
+def decode_payload(payload):
+    (flags, axes, buttons, sequence, loop_time, max_loop_time, lateness,
+     max_lateness, missed_ticks) = struct.unpack_from('<BBBB5H', payload, 0)
+    offset = 14
+
+    button_bytes = (buttons + 7) // 8
+    bitmask = int.from_bytes(payload[offset:offset + button_bytes], 'little')
+    offset += button_bytes
+
+    raw_axis = struct.unpack_from('<{}h'.format(axes), payload, offset)
+    offset += 2 * axes
+    axis = struct.unpack_from('<{}h'.format(axes), payload, offset)
+    offset += 2 * axes
+
+    frame = {
+        'sequence': sequence,
+        'loop_time': loop_time,
+        'max_loop_time': max_loop_time,
+        'lateness': lateness,
+        'max_lateness': max_lateness,
+        'missed_ticks': missed_ticks,
+        'buttons': [(bitmask >> i) & 1 for i in range(buttons)],
+        'raw_axis': raw_axis,
+        'axis': axis,
+    }
+
+    if flags & FLAG_LATENCY:
+        frame['latency'] = struct.unpack_from('<4H', payload, offset)
+
+    return frame
+
+
+def read_frames(stream, stop_at_eof):
+    # an empty read is the end of a capture file, but only a timeout on a
+    # serial port (e.g. while the board resets), so keep waiting there
+    buffer = bytearray()
+    while True:
+        data = stream.read(64)
+        if not data:
+            if stop_at_eof:
+                return
+            continue
+        buffer += data
+
+        while True:
+            start = buffer.find(FRAME_SYNC)
+            if start < 0:
+                del buffer[:-1]
+                break
+            if len(buffer) < start + 3:
+                break
+
+            length = buffer[start + 2]
+            end = start + 3 + length + 1
+            if len(buffer) < end:
+                break
+
+            payload = bytes(buffer[start + 3:end - 1])
+            if (sum(payload) + buffer[end - 1]) & 0xFF == 0:
+                yield decode_payload(payload)
+                del buffer[:end]
+            else:
+                # not a real frame: resync on the next sync pattern
+                del buffer[:start + 1]
+
+
+def format_frame(frame, last_sequence):
+    line = ('#{:03d} loop: {:5d}/{:5d} us  late: {:5d}/{:5d} us  missed: {}  '
+            'B: {}  A: {}  raw: {}').format(
+        frame['sequence'], frame['loop_time'], frame['max_loop_time'],
+        frame['lateness'], frame['max_lateness'], frame['missed_ticks'],
+        ''.join(str(b) for b in frame['buttons']),
+        ' '.join('{:6d}'.format(a) for a in frame['axis']),
+        ' '.join('{:4d}'.format(a) for a in frame['raw_axis']))
+
+    if 'latency' in frame:
+        line += '  latency: {}/{} us [report: {}/{} us]'.format(
+            *frame['latency'])
+
+    if last_sequence is not None:
+        dropped = (frame['sequence'] - last_sequence - 1) & 0xFF
+        if dropped:
+            line += '  ({} frames dropped)'.format(dropped)
+
+    return line
+
+
+def decode(source):
+    is_file = os.path.exists(source) and not source.startswith('/dev/')
+    if is_file:
+        stream = open(source, 'rb')
+    else:
+        import serial
+        stream = serial.Serial(source, 115200, timeout=1)
+
+    last_sequence = None
+    with stream:
+        for frame in read_frames(stream, is_file):
+            print(format_frame(frame, last_sequence))
+            last_sequence = frame['sequence']
+
+
+if __name__ == "__main__":
+    USAGE = """agrostick_telemetry.py - Decode the Agrostick binary debug telemetry
+    usage: python3 agrostick_telemetry.py serial_port|capture_file"""
+
+    if len(sys.argv) != 2:
+        print(USAGE)
+        sys.exit(1)
+
+    try:
+        decode(sys.argv[1])
+    except KeyboardInterrupt:
+        pass
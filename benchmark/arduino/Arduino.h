@@ -0,0 +1,104 @@
+#pragma once
+
+/*
+ *  Host stand-in for the Arduino AVR core, providing just what the sketches
+ *  in this repository need to be compiled and benchmarked natively.  Inputs
+ *  are synthetic and outputs are discarded.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef F_CPU
+#define F_CPU           16000000UL
+#endif
+
+#define PROGMEM
+#define pgm_read_byte(address)  (*(const uint8_t *)(address))
+#define pgm_read_word(address)  (*(const uint16_t *)(address))
+#define memcpy_P        memcpy
+
+#define ISR(vector)     extern "C" void vector(void)
+#define cli()
+#define sei()
+#define _BV(bit)        (1 << (bit))
+
+#define HIGH            1
+#define LOW             0
+#define INPUT           0x0
+#define OUTPUT          0x1
+#define INPUT_PULLUP    0x2
+
+#define A0              18
+#define A1              19
+#define A2              20
+#define A3              21
+#define A4              22
+#define A5              23
+
+/* ATmega32U4 (Leonardo) mapping of A0... to the ADC channels */
+inline uint8_t analogPinToChannel(uint8_t pin)
+{
+    static const uint8_t CHANNEL[] = {7, 6, 5, 4, 1, 0, 8, 10, 11, 12, 13, 9};
+    return CHANNEL[pin];
+}
+
+#define constrain(amt, low, high) \
+        ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+long map(long x, long inMin, long inMax, long outMin, long outMax);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+
+/* Every call advances the virtual clock by ARDUINO_SHIM_MICROS_STEP */
+#define ARDUINO_SHIM_MICROS_STEP    500
+unsigned long millis(void);
+unsigned long micros(void);
+
+/* Registers (ATmega32U4) */
+extern volatile uint8_t SREG;
+extern volatile uint8_t TCCR3A, TCCR3B, TIMSK3, TIFR3;
+extern volatile uint16_t OCR3A, TCNT3;
+extern volatile uint8_t ADMUX, ADCSRA, ADCSRB, ADCL, ADCH, DIDR0, DIDR2;
+extern volatile uint16_t ADC;
+extern volatile uint8_t PORTB, DDRB, PORTD, DDRD, PORTF, DDRF;
+
+/* Every digital pin is mapped on PORTB */
+inline uint8_t digitalPinToPort(uint8_t)
+{
+    return 2;
+}
+
+inline uint8_t digitalPinToBitMask(uint8_t pin)
+{
+    return static_cast<uint8_t>(_BV(pin & 0x07));
+}
+
+inline volatile uint8_t *portOutputRegister(uint8_t)
+{
+    return &PORTB;
+}
+
+enum {
+    CS30 = 0, CS31 = 1, CS32 = 2, WGM32 = 3, WGM33 = 4,
+    OCIE3A = 1, OCF3A = 1,
+    ADPS0 = 0, ADPS1 = 1, ADPS2 = 2, ADIE = 3, ADIF = 4, ADATE = 5,
+    ADSC = 6, ADEN = 7, MUX5 = 5, ADLAR = 5, REFS0 = 6, REFS1 = 7,
+};
+
+class HardwareSerial
+{
+public:
+    void begin(unsigned long baud);
+    int availableForWrite();
+    size_t write(uint8_t value);
+    size_t write(const uint8_t *buffer, size_t size);
+    size_t println(const char *text);
+};
+
+extern HardwareSerial Serial;
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdint.h>
+
+class EEPROMClass
+{
+public:
+    uint8_t &operator[](int index) { return m_data[index & 0x3FF]; }
+
+private:
+    uint8_t m_data[1024] = {};
+};
+
+extern EEPROMClass EEPROM;
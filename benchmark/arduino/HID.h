@@ -0,0 +1,24 @@
+#pragma once
+
+#include "Arduino.h"
+
+#define _USING_HID
+
+class HIDSubDescriptor
+{
+public:
+    HIDSubDescriptor(const void *data, uint16_t length) :
+        data{data}, length{length} {}
+
+    const void  *data;
+    uint16_t    length;
+};
+
+class HID_
+{
+public:
+    void AppendDescriptor(HIDSubDescriptor *node);
+    int SendReport(uint8_t id, const void *data, int length);
+};
+
+HID_ &HID();
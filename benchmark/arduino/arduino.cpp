@@ -0,0 +1,91 @@
+#include "Arduino.h"
+#include "EEPROM.h"
+#include "HID.h"
+
+volatile uint8_t SREG;
+volatile uint8_t TCCR3A, TCCR3B, TIMSK3, TIFR3;
+volatile uint16_t OCR3A, TCNT3;
+volatile uint8_t ADMUX, ADCSRA, ADCSRB, ADCL, ADCH, DIDR0, DIDR2;
+volatile uint16_t ADC;
+volatile uint8_t PORTB, DDRB, PORTD, DDRD, PORTF, DDRF;
+
+HardwareSerial Serial;
+EEPROMClass EEPROM;
+
+static unsigned long s_micros = 0;
+static uint32_t s_inputPhase = 0;
+
+long map(long x, long inMin, long inMax, long outMin, long outMax)
+{
+    return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+void pinMode(uint8_t, uint8_t)
+{
+}
+
+void digitalWrite(uint8_t, uint8_t)
+{
+}
+
+int digitalRead(uint8_t pin)
+{
+    // every pin toggles with a different period
+    return ((++s_inputPhase >> 6) + pin) & 0x01;
+}
+
+int analogRead(uint8_t pin)
+{
+    // slow triangle wave over the whole ADC range
+    uint32_t phase = (++s_inputPhase + pin * 97) % 2046;
+    return static_cast<int>(phase < 1023 ? phase : 2046 - phase);
+}
+
+unsigned long millis(void)
+{
+    return micros() / 1000;
+}
+
+unsigned long micros(void)
+{
+    return s_micros += ARDUINO_SHIM_MICROS_STEP;
+}
+
+void HardwareSerial::begin(unsigned long)
+{
+}
+
+int HardwareSerial::availableForWrite()
+{
+    return 64;
+}
+
+size_t HardwareSerial::write(uint8_t)
+{
+    return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *, size_t size)
+{
+    return size;
+}
+
+size_t HardwareSerial::println(const char *text)
+{
+    return strlen(text) + 2;
+}
+
+void HID_::AppendDescriptor(HIDSubDescriptor *)
+{
+}
+
+int HID_::SendReport(uint8_t, const void *, int length)
+{
+    return length;
+}
+
+HID_ &HID()
+{
+    static HID_ hid;
+    return hid;
+}
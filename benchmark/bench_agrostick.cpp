@@ -0,0 +1,107 @@
+#include "benchmark.h"
+
+#include "Arduino.h"
+#include "../agrostick/agrostick.ino"
+
+/**
+ *  Return a panel initialized in the requested emulation mode (the mode is
+ *  read back from the EEPROM in begin()).
+ */
+static AgrostickPanel &panel(bool joystick)
+{
+    static AgrostickPanel panels[2];
+    static bool initialized[2] {};
+
+    if (!initialized[joystick]) {
+        EEPROM[0] = joystick ? 0x44 : 0x00;
+        panels[joystick].begin();
+        initialized[joystick] = true;
+    }
+    return panels[joystick];
+}
+
+/**
+ *  Complete a background ADC conversion, with a synthetic reading on the
+ *  selected channel.
+ */
+static void adcConversion()
+{
+    ADC = static_cast<uint16_t>(analogRead(ADMUX & 0x07));
+    ADC_vect();
+}
+
+static void tick(AgrostickPanel &agrostick, uint64_t operations)
+{
+    for (uint64_t i = 0; i < operations; ++i) {
+        // keep the axes moving, one conversion per axis
+        for (uint8_t axis = 0; axis < AgrostickPanel::AXIS_COUNT; ++axis)
+            adcConversion();
+        agrostick.readInputs();
+        agrostick.writeOutput();
+        agrostick.sendReport();
+    }
+}
+
+static Benchmark joystickTick{"agrostick_tick_joystick", "ticks", 200000,
+    [](uint64_t operations) { tick(panel(true), operations); }};
+
+static Benchmark mouseTick{"agrostick_tick_mouse", "ticks", 200000,
+    [](uint64_t operations) { tick(panel(false), operations); }};
+
+static Benchmark buttonScan{"agrostick_button_scan", "scans", 500000,
+    [](uint64_t operations) {
+        auto &agrostick = panel(true);
+        for (uint64_t i = 0; i < operations; ++i)
+            agrostick.scanButtons();
+    }};
+
+static Benchmark adcInterrupt{"agrostick_adc_conversion", "conversions", 1000000,
+    [](uint64_t operations) {
+        panel(true);
+        for (uint64_t i = 0; i < operations; ++i)
+            adcConversion();
+    }};
+
+// ** Control panel variant: 3 direct axes and 6 axes on a CD4051 on A3 ** //
+using AgrostickMuxPanel = Agrostick<9, 7>;
+
+template <>
+const AgrostickAxis AgrostickMuxPanel::AGROSTICK_AXIS[AgrostickMuxPanel::AXIS_COUNT] {
+    {{85, 935, 512, 30, false}, A0, BackgroundAdc::NO_MUX},
+    {{85, 935, 515, 30, true}, A1, BackgroundAdc::NO_MUX},
+    {{95, 925, 500, 30, false}, A2, BackgroundAdc::NO_MUX},
+    {{0, 1023, 512, 30, false}, A3, 0},
+    {{0, 1023, 512, 30, false}, A3, 1},
+    {{0, 1023, 512, 30, false}, A3, 2},
+    {{0, 1023, 512, 30, false}, A3, 3},
+    {{0, 1023, 512, 30, false}, A3, 4},
+    {{0, 1023, 512, 30, false}, A3, 5},
+};
+
+template <>
+const AgrostickButton AgrostickMuxPanel::AGROSTICK_BUTTON[AgrostickMuxPanel::BUTTON_COUNT] {
+    {true, true, 2},
+    {true, true, 3},
+    {true, true, 4},
+    {true, true, 5},
+    {false, false, 6},
+    {false, false, 7},
+    {false, false, 8},
+};
+
+template <>
+const uint8_t AgrostickMuxPanel::AGROSTICK_MUX_SELECT[BackgroundAdc::MUX_SELECT_LINES] {
+    9, 10, 13,
+};
+
+static Benchmark adcInterruptMux{"agrostick_adc_conversion_mux", "conversions", 1000000,
+    [](uint64_t operations) {
+        static AgrostickMuxPanel muxPanel;
+        static bool initialized {false};
+        if (!initialized) {
+            muxPanel.begin();
+            initialized = true;
+        }
+        for (uint64_t i = 0; i < operations; ++i)
+            adcConversion();
+    }};
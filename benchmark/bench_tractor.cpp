@@ -0,0 +1,124 @@
+#include "benchmark.h"
+
+extern "C" {
+#include "button_manager.h"
+#include "control_loop.h"
+#include "ecu_bus.h"
+#include "sound_manager.h"
+#include "tractor_model.h"
+}
+
+static const uint32_t SAMPLE_RATE_HZ        = 8000;
+
+static const uint8_t ADC_LEVEL_OFF          = 0;
+static const uint8_t ADC_LEVEL_ON           = 56;
+static const uint8_t ADC_LEVEL_ON_HORN      = 70;
+static const uint8_t ADC_LEVEL_ON_START     = 128;
+
+/**
+ *  Scripted driver inputs for a given model tick, repeating every minute:
+ *  key OFF, cranking for 5 s, a throttle ramp up and down with a "Dixie"
+ *  request in the middle, and key OFF again.
+ */
+static void scenarioInputs(uint32_t tick, uint8_t &adcButtons, uint8_t &adcThrottle)
+{
+    uint32_t t = tick % (60 * 25);
+
+    if (t < 25)
+        adcButtons = ADC_LEVEL_OFF;
+    else if (t < 6 * 25)
+        adcButtons = ADC_LEVEL_ON_START;
+    else if (t == 20 * 25)
+        adcButtons = ADC_LEVEL_ON_HORN;
+    else if (t < 50 * 25)
+        adcButtons = ADC_LEVEL_ON;
+    else
+        adcButtons = ADC_LEVEL_OFF;
+
+    // up in 28 s, down in 28 s, then idle for the last 4 s of the minute
+    uint32_t ramp = (t < 28 * 25) ? t : (t < 56 * 25 ? 56 * 25 - t : 0);
+    adcThrottle = static_cast<uint8_t>(ADC_THROTTLE_IDLE + (ramp * 192) / (28 * 25));
+}
+
+/**
+ *  Bring all the firmware modules back to their initial state, so that every
+ *  repetition starts from the same state.
+ */
+static void resetFirmware()
+{
+    button_reset();
+    tractor_reset();
+    audio_reset();
+    ecu_bus_reset();
+    control_reset();
+}
+
+static Benchmark audioSample{"audio_get_next_sample", "samples", 1000000,
+    [](uint64_t operations) {
+        resetFirmware();
+        uint8_t sample = 0;
+        for (uint64_t i = 0; i < operations; ++i) {
+            if (i % 16000 == 0)
+                audio_play_horn_song(SONG_DIXIE);
+            sample ^= audio_get_next_sample(
+                    static_cast<uint8_t>(ENGINE_SPEED_IDLE + (i >> 10) % 104));
+        }
+        doNotOptimize(sample);
+    }};
+
+static Benchmark tractorModel{"tractor_update_model", "ticks", 250000,
+    [](uint64_t operations) {
+        resetFirmware();
+        for (uint64_t i = 0; i < operations; ++i) {
+            uint8_t adcButtons, adcThrottle;
+            scenarioInputs(static_cast<uint32_t>(i), adcButtons, adcThrottle);
+            tractor_set_ignition_position(adcButtons == ADC_LEVEL_ON_START ?
+                    IGNITION_START : (adcButtons ? IGNITION_ON : IGNITION_OFF));
+            tractor_set_engine_speed_setpoint(
+                    ENGINE_SPEED_IDLE + ((adcThrottle - ADC_THROTTLE_IDLE) >> 1));
+            doNotOptimize(tractor_update_model());
+        }
+    }};
+
+static Benchmark buttonDecode{"button_set_adc_value", "decodes", 1024000,
+    [](uint64_t operations) {
+        uint8_t pressed = 0;
+        for (uint64_t i = 0; i < operations; ++i) {
+            button_set_adc_value(static_cast<uint8_t>(i * 37));
+            pressed ^= button_is_clicked(BUTTON_HORN);
+        }
+        doNotOptimize(pressed);
+    }};
+
+/**
+ *  End-to-end firmware loop (control_loop.h, the main loop body of main.c):
+ *  one operation is one simulated second, so the reported throughput is the
+ *  real-time factor.  Every repetition runs the scripted scenario for one
+ *  hour from the initial state.
+ */
+static Benchmark realTimeFactor{"firmware_one_hour_rtf", "simulated s", 3600,
+    [](uint64_t operations) {
+        resetFirmware();
+        uint8_t adcButtons = ADC_LEVEL_OFF;
+        uint8_t adcThrottle = 0;
+        uint8_t output = 0;
+        uint32_t tick = 0;
+
+        for (uint64_t second = 0; second < operations; ++second) {
+            for (uint32_t i = 0; i < SAMPLE_RATE_HZ; ++i) {
+                output ^= control_get_next_sample();
+
+                if (control_is_model_update_due()) {
+                    control_update_model(adcThrottle, adcButtons);
+
+                    // the slave ECU side is not part of the firmware
+                    uint8_t byte;
+                    while (ecu_bus_loopback_read(&byte))
+                        doNotOptimize(byte);
+
+                    scenarioInputs(tick++, adcButtons, adcThrottle);
+                }
+            }
+        }
+        doNotOptimize(output);
+    }};
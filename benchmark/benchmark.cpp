@@ -0,0 +1,217 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <numeric>
+#include <sstream>
+
+static const unsigned DEFAULT_WARMUP        = 3;
+static const unsigned DEFAULT_REPETITIONS   = 20;
+static const double DEFAULT_THRESHOLD       = 10.0;
+
+Benchmark::Benchmark(const char *name, const char *unit, uint64_t operations,
+        Function function) :
+    m_name{name},
+    m_unit{unit},
+    m_operations{operations},
+    m_function{function}
+{
+    registry().push_back(this);
+}
+
+std::vector<Benchmark *> &Benchmark::registry()
+{
+    static std::vector<Benchmark *> benchmarks;
+    return benchmarks;
+}
+
+Benchmark::Result Benchmark::run(unsigned warmup, unsigned repetitions) const
+{
+    for (unsigned i = 0; i < warmup; ++i)
+        m_function(m_operations);
+
+    Result result{m_name, m_unit, m_operations, {}};
+    for (unsigned i = 0; i < repetitions; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        m_function(m_operations);
+        auto stop = std::chrono::steady_clock::now();
+
+        std::chrono::duration<double, std::nano> elapsed{stop - start};
+        result.nsPerOperation.push_back(elapsed.count() / m_operations);
+    }
+    std::sort(result.nsPerOperation.begin(), result.nsPerOperation.end());
+    return result;
+}
+
+double Benchmark::Result::percentile(double p) const
+{
+    // nearest-rank percentile
+    auto rank = static_cast<size_t>(std::ceil(p / 100.0 * nsPerOperation.size()));
+    return nsPerOperation[std::max<size_t>(rank, 1) - 1];
+}
+
+double Benchmark::Result::mean() const
+{
+    return std::accumulate(nsPerOperation.begin(), nsPerOperation.end(), 0.0) /
+            nsPerOperation.size();
+}
+
+double Benchmark::Result::throughput() const
+{
+    return 1e9 / percentile(50);
+}
+
+static void printResult(const Benchmark::Result &result)
+{
+    std::printf("%-32s %14.1f %-16s p50 %10.2f ns  p90 %10.2f ns  p99 %10.2f ns\n",
+            result.name.c_str(), result.throughput(),
+            (result.unit + "/s").c_str(), result.percentile(50),
+            result.percentile(90), result.percentile(99));
+}
+
+static std::string toJson(const std::vector<Benchmark::Result> &results)
+{
+    std::ostringstream json;
+    json.precision(6);
+    json << std::fixed << "{\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto &r = results[i];
+        json << "    {\n"
+             << "      \"name\": \"" << r.name << "\",\n"
+             << "      \"unit\": \"" << r.unit << "\",\n"
+             << "      \"operations\": " << r.operations << ",\n"
+             << "      \"repetitions\": " << r.nsPerOperation.size() << ",\n"
+             << "      \"throughput\": " << r.throughput() << ",\n"
+             << "      \"ns_per_op\": {"
+             << "\"min\": " << r.nsPerOperation.front() << ", "
+             << "\"p50\": " << r.percentile(50) << ", "
+             << "\"p90\": " << r.percentile(90) << ", "
+             << "\"p99\": " << r.percentile(99) << ", "
+             << "\"max\": " << r.nsPerOperation.back() << ", "
+             << "\"mean\": " << r.mean() << "}\n"
+             << "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    json << "  ]\n}\n";
+    return json.str();
+}
+
+/**
+ *  Read the median time per operation of every benchmark from a JSON file
+ *  written by this program.  This is not a generic JSON parser: it only
+ *  relies on the "name" key preceding the "p50" key of the same benchmark.
+ */
+static std::map<std::string, double> readBaseline(const char *filename)
+{
+    std::ifstream file{filename};
+    if (!file) {
+        std::fprintf(stderr, "Cannot open baseline %s\n", filename);
+        std::exit(2);
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    const std::string json{buffer.str()};
+
+    std::map<std::string, double> baseline;
+    size_t position = 0;
+    while ((position = json.find("\"name\": \"", position)) != std::string::npos) {
+        position += std::strlen("\"name\": \"");
+        auto end = json.find('"', position);
+        std::string name{json.substr(position, end - position)};
+
+        auto p50 = json.find("\"p50\": ", end);
+        if (p50 == std::string::npos)
+            break;
+        baseline[name] = std::strtod(json.c_str() + p50 + std::strlen("\"p50\": "), nullptr);
+        position = p50;
+    }
+    return baseline;
+}
+
+static int compare(const std::vector<Benchmark::Result> &results,
+        const char *filename, double threshold)
+{
+    auto baseline = readBaseline(filename);
+    int regressions = 0;
+
+    std::printf("\nComparison against %s (threshold %.1f%%)\n", filename, threshold);
+    for (const auto &result : results) {
+        auto it = baseline.find(result.name);
+        if (it == baseline.end()) {
+            std::printf("%-32s %10s\n", result.name.c_str(), "new");
+            continue;
+        }
+
+        double change = (result.percentile(50) - it->second) / it->second * 100.0;
+        bool regression = change > threshold;
+        regressions += regression;
+        std::printf("%-32s %+9.1f%% %s\n", result.name.c_str(), change,
+                regression ? "REGRESSION" : "ok");
+    }
+    return regressions ? 1 : 0;
+}
+
+static void usage(const char *program)
+{
+    std::printf("usage: %s [options]\n"
+            "  --filter TEXT        run only benchmarks whose name contains TEXT\n"
+            "  --warmup N           warmup runs (default %u)\n"
+            "  --repetitions N      timed repetitions (default %u)\n"
+            "  --json FILE          write the results as JSON\n"
+            "  --compare FILE       compare the median against a saved JSON baseline\n"
+            "  --threshold PCT      slowdown reported as regression (default %.0f)\n",
+            program, DEFAULT_WARMUP, DEFAULT_REPETITIONS, DEFAULT_THRESHOLD);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *filter = "";
+    const char *jsonFile = nullptr;
+    const char *baselineFile = nullptr;
+    unsigned warmup = DEFAULT_WARMUP;
+    unsigned repetitions = DEFAULT_REPETITIONS;
+    double threshold = DEFAULT_THRESHOLD;
+
+    for (int i = 1; i < argc; ++i) {
+        auto option = [&](const char *name) {
+            return std::strcmp(argv[i], name) == 0 && i + 1 < argc;
+        };
+
+        if (option("--filter"))
+            filter = argv[++i];
+        else if (option("--warmup"))
+            warmup = std::atoi(argv[++i]);
+        else if (option("--repetitions"))
+            repetitions = std::max(1, std::atoi(argv[++i]));
+        else if (option("--json"))
+            jsonFile = argv[++i];
+        else if (option("--compare"))
+            baselineFile = argv[++i];
+        else if (option("--threshold"))
+            threshold = std::atof(argv[++i]);
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    std::vector<Benchmark::Result> results;
+    for (const auto *benchmark : Benchmark::registry()) {
+        if (benchmark->name().find(filter) == std::string::npos)
+            continue;
+        results.push_back(benchmark->run(warmup, repetitions));
+        printResult(results.back());
+    }
+
+    if (jsonFile) {
+        std::ofstream file{jsonFile};
+        file << toJson(results);
+    }
+
+    return baselineFile ? compare(results, baselineFile, threshold) : 0;
+}
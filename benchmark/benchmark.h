@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ *  Minimal benchmark harness.
+ *
+ *  Every benchmark is a function that performs a given number of operations.
+ *  The harness runs it a few times to warm up the caches, then times a number
+ *  of repetitions and reports the distribution of the time per operation
+ *  (min, percentiles, max) together with the median throughput.
+ */
+class Benchmark
+{
+public:
+    using Function = std::function<void(uint64_t operations)>;
+
+    struct Result {
+        std::string         name;
+        std::string         unit;
+        uint64_t            operations;
+        std::vector<double> nsPerOperation;     // sorted, one per repetition
+
+        double percentile(double p) const;
+        double mean() const;
+        double throughput() const;              // operations per second (p50)
+    };
+
+    Benchmark(const char *name, const char *unit, uint64_t operations,
+            Function function);
+
+    static std::vector<Benchmark *> &registry();
+
+    Result run(unsigned warmup, unsigned repetitions) const;
+
+    const std::string &name() const { return m_name; }
+
+private:
+    std::string m_name;
+    std::string m_unit;
+    uint64_t    m_operations;
+    Function    m_function;
+};
+
+/**
+ *  Prevent the compiler from optimizing away a computed value.
+ */
+template <typename T>
+inline void doNotOptimize(const T &value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
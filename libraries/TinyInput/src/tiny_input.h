@@ -0,0 +1,349 @@
+/**
+ *  @file tiny_input.h
+ *  @author William Spinelli <william.spinelli(on)gmail>
+ *
+ *  @brief Input pipeline shared by the firmwares of this repository.
+ *
+ *  This header-only library collects the building blocks used to turn raw
+ *  ADC readings and digital levels into controls:
+ *   - ADC scan scheduler: round robin over a list of slots, to be advanced
+ *     from the ADC conversion complete interrupt (background sampling).
+ *   - Oversampler: averages 2^N consecutive readings of a slot.
+ *   - Resistive ladder decoder: maps an ADC reading to a bitmask of buttons
+ *     through a table of thresholds.
+ *   - Integrator debounce: moves an integrator towards the raw level at every
+ *     sample and reports press and release events with hysteresis.
+ *   - Edge events: latches the rising edges of a bitmask of buttons until
+ *     they are consumed.
+ *   - Axis scaling: calibration range, dead band around the center and
+ *     optional reversal, giving a value between -32767 and 32767.
+ *   - Response curves: piecewise linear look-up table applied to a scaled
+ *     axis value.
+ *
+ *  Everything is a static inline function working on caller-owned state and
+ *  constant configuration, so that the compiler can fold the configuration
+ *  of each call site and no code is emitted for the unused stages.  The
+ *  library is plain C99 and can be used from both C and C++ (Arduino).
+ *  Tables passed to the decoder and to the curves are read from the flash
+ *  on AVR, and must be declared with TINY_INPUT_PROGMEM.
+ */
+
+#ifndef TINY_INPUT_H
+#define TINY_INPUT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+
+/**
+ *  @def TINY_INPUT_PROGMEM
+ *  @brief Attribute used to place the configuration tables in flash.
+ */
+#define TINY_INPUT_PROGMEM              PROGMEM
+
+/**
+ *  @def tiny_input_read_byte(address)
+ *  @brief Read a byte from a table declared with TINY_INPUT_PROGMEM.
+ */
+#define tiny_input_read_byte(address)   pgm_read_byte(address)
+
+/**
+ *  @def tiny_input_read_word(address)
+ *  @brief Read a word from a table declared with TINY_INPUT_PROGMEM.
+ */
+#define tiny_input_read_word(address)   pgm_read_word(address)
+#else
+#define TINY_INPUT_PROGMEM
+#define tiny_input_read_byte(address)   (*(const uint8_t *)(address))
+#define tiny_input_read_word(address)   (*(const uint16_t *)(address))
+#endif
+
+/**
+ *  @def TINY_INPUT_AXIS_MAX
+ *  @brief The magnitude of a fully deflected axis.
+ */
+#define TINY_INPUT_AXIS_MAX     32767
+
+/**
+ *  @def TINY_INPUT_CURVE_POINTS
+ *  @brief The number of points of a response curve.
+ *
+ *  A curve holds the output for the axis magnitudes 0, 2048, 4096, ...,
+ *  32768 (the last point is reached only by extrapolation), and is
+ *  interpolated linearly between the points.
+ */
+#define TINY_INPUT_CURVE_POINTS 17
+
+/**
+ *  @brief Enumeration of the events reported by the debounce.
+ */
+enum {
+    TINY_INPUT_EVENT_NONE,      /**< The debounced level did not change. */
+    TINY_INPUT_EVENT_PRESS,     /**< The input has been pressed. */
+    TINY_INPUT_EVENT_RELEASE,   /**< The input has been released. */
+};
+
+/**
+ *  @brief Structure holding the status of an ADC scan.
+ */
+typedef struct {
+    uint8_t slot;               /**< The slot being converted. */
+    uint8_t count;              /**< The number of slots in a round. */
+} TinyAdcScan;
+
+/**
+ *  @brief Structure holding the status of an oversampler.
+ */
+typedef struct {
+    uint16_t    sum;            /**< The sum of the readings so far. */
+    uint8_t     count;          /**< The number of readings so far. */
+} TinyOversampler;
+
+/**
+ *  @brief Structure holding a step of a resistive ladder.
+ */
+typedef struct {
+    uint8_t threshold;          /**< The highest ADC reading of the step. */
+    uint8_t level;              /**< The buttons pressed (bitmask). */
+} TinyLadderStep;
+
+/**
+ *  @brief Structure holding the configuration of an integrator debounce.
+ */
+typedef struct {
+    uint8_t integrator_max;     /**< The saturation of the integrator. */
+    uint8_t press_threshold;    /**< The integrator value that reports a press. */
+    uint8_t release_threshold;  /**< The integrator value that reports a release. */
+} TinyDebounceConfig;
+
+/**
+ *  @brief Structure holding the status of an integrator debounce.
+ */
+typedef struct {
+    uint8_t integrator;         /**< The integrator (0 = fully released). */
+    uint8_t level;              /**< The debounced level. */
+} TinyDebounce;
+
+/**
+ *  @brief Structure holding the edge events of a bitmask of buttons.
+ */
+typedef struct {
+    uint8_t level;              /**< The current level of the buttons. */
+    uint8_t pressed;            /**< The rising edges not yet consumed. */
+} TinyEvents;
+
+/**
+ *  @brief Structure holding the calibration of an analog axis.
+ */
+typedef struct {
+    int16_t     min_value;      /**< The ADC reading at full negative deflection. */
+    int16_t     max_value;      /**< The ADC reading at full positive deflection. */
+    int16_t     zero_value;     /**< The ADC reading at the center. */
+    uint8_t     dead_band;      /**< The half width of the dead band. */
+    bool        reversed;       /**< Whether the axis is reversed. */
+} TinyAxisConfig;
+
+/**
+ *  @brief Start a new round of an ADC scan.
+ *  @param scan The scan status.
+ *  @param count The number of slots in a round (at least 1).
+ *  @return The first slot to convert.
+ */
+static inline uint8_t tiny_adc_scan_begin(TinyAdcScan *scan, uint8_t count)
+{
+    scan->slot = 0;
+    scan->count = count;
+    return 0;
+}
+
+/**
+ *  @brief Move an ADC scan to the next slot.
+ *
+ *  This function is meant to be called from the conversion complete
+ *  interrupt, after the result of the current slot has been stored.
+ *  @param scan The scan status.
+ *  @return true if the round is complete (the scan restarts from slot 0).
+ */
+static inline bool tiny_adc_scan_advance(TinyAdcScan *scan)
+{
+    if (++scan->slot < scan->count)
+        return false;
+    scan->slot = 0;
+    return true;
+}
+
+/**
+ *  @brief Add a reading to an oversampler.
+ *  @param oversampler The oversampler status.
+ *  @param reading The ADC reading (at most 12 bits when averaging 16 readings).
+ *  @param shift The number of readings averaged, as power of 2.
+ *  @param average The average of the readings, filled only when true is
+ *  returned.
+ *  @return true if the reading completed a set of 2^shift readings.
+ */
+static inline bool tiny_oversampler_add(TinyOversampler *oversampler,
+        uint16_t reading, uint8_t shift, uint16_t *average)
+{
+    oversampler->sum += reading;
+    if (++oversampler->count < (uint8_t)(1 << shift))
+        return false;
+
+    // round to nearest
+    *average = (uint16_t)((oversampler->sum + ((1 << shift) >> 1)) >> shift);
+    oversampler->sum = 0;
+    oversampler->count = 0;
+    return true;
+}
+
+/**
+ *  @brief Decode the buttons on a resistive ladder.
+ *  @param steps The steps of the ladder, sorted by increasing threshold
+ *  (declared with TINY_INPUT_PROGMEM).
+ *  @param count The number of steps.
+ *  @param top_level The buttons pressed above the last threshold.
+ *  @param reading The ADC reading.
+ *  @return The buttons pressed (bitmask).
+ */
+static inline uint8_t tiny_ladder_decode(const TinyLadderStep *steps,
+        uint8_t count, uint8_t top_level, uint8_t reading)
+{
+    for (uint8_t i = 0; i < count; ++i) {
+        if (reading <= tiny_input_read_byte(&steps[i].threshold))
+            return tiny_input_read_byte(&steps[i].level);
+    }
+    return top_level;
+}
+
+/**
+ *  @brief Feed a raw level to an integrator debounce.
+ *
+ *  The integrator moves one step towards the raw level at every sample,
+ *  saturating at integrator_max.  A press is reported when the integrator
+ *  reaches press_threshold and a release when it falls back to
+ *  release_threshold.
+ *  @param debounce The debounce status.
+ *  @param config The debounce configuration.
+ *  @param raw_level The raw level of the input.
+ *  @return The event generated by the sample (TINY_INPUT_EVENT_NONE...).
+ */
+static inline uint8_t tiny_debounce_update(TinyDebounce *debounce,
+        const TinyDebounceConfig *config, bool raw_level)
+{
+    if (raw_level) {
+        if (debounce->integrator < config->integrator_max)
+            ++debounce->integrator;
+    } else if (debounce->integrator > 0) {
+        --debounce->integrator;
+    }
+
+    if (!debounce->level && debounce->integrator >= config->press_threshold) {
+        debounce->level = 1;
+        return TINY_INPUT_EVENT_PRESS;
+    }
+    if (debounce->level && debounce->integrator <= config->release_threshold) {
+        debounce->level = 0;
+        return TINY_INPUT_EVENT_RELEASE;
+    }
+    return TINY_INPUT_EVENT_NONE;
+}
+
+/**
+ *  @brief Update the level of a bitmask of buttons and latch the rising edges.
+ *  @param events The events status.
+ *  @param level The new level of the buttons (bitmask).
+ */
+static inline void tiny_events_update(TinyEvents *events, uint8_t level)
+{
+    events->pressed |= (uint8_t)(~events->level & level);
+    events->level = level;
+}
+
+/**
+ *  @brief Check and consume the rising edges of some buttons.
+ *  @param events The events status.
+ *  @param mask The buttons to check (bitmask).
+ *  @return The buttons in mask that have been pressed since the last call.
+ */
+static inline uint8_t tiny_events_take(TinyEvents *events, uint8_t mask)
+{
+    uint8_t pressed = events->pressed & mask;
+    events->pressed &= (uint8_t)~mask;
+    return pressed;
+}
+
+/**
+ *  @brief Map a value between two ranges, like the Arduino map().
+ *  @param value The value to map.
+ *  @param in_min The lower bound of the input range.
+ *  @param in_max The upper bound of the input range.
+ *  @param out_min The lower bound of the output range.
+ *  @param out_max The upper bound of the output range.
+ *  @return The mapped value.
+ */
+static inline int32_t tiny_input_map(int32_t value, int32_t in_min,
+        int32_t in_max, int32_t out_min, int32_t out_max)
+{
+    return (value - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+/**
+ *  @brief Scale an ADC reading to an axis value.
+ *
+ *  The reading is clamped to the calibration range and mapped to -32767..0
+ *  below the dead band and to 0..32767 above it, while the dead band around
+ *  the center gives 0.
+ *  @param config The axis calibration.
+ *  @param reading The ADC reading.
+ *  @return The axis value (-32767 to 32767).
+ */
+static inline int16_t tiny_axis_scale(const TinyAxisConfig *config,
+        int16_t reading)
+{
+    const int16_t low_max = config->zero_value - config->dead_band;
+    const int16_t high_min = config->zero_value + config->dead_band;
+
+    if (reading < config->min_value)
+        reading = config->min_value;
+    else if (reading > config->max_value)
+        reading = config->max_value;
+
+    int16_t value;
+    if (reading <= low_max)
+        value = (int16_t)tiny_input_map(reading, config->min_value, low_max,
+                -TINY_INPUT_AXIS_MAX, 0);
+    else if (reading >= high_min)
+        value = (int16_t)tiny_input_map(reading, high_min, config->max_value,
+                0, TINY_INPUT_AXIS_MAX);
+    else
+        value = 0;
+
+    return config->reversed ? -value : value;
+}
+
+/**
+ *  @brief Apply a response curve to an axis value.
+ *
+ *  The curve is applied to the magnitude of the value, the sign is kept.
+ *  @param curve The TINY_INPUT_CURVE_POINTS outputs of the curve (declared
+ *  with TINY_INPUT_PROGMEM), or NULL for a linear response.
+ *  @param value The axis value (-32767 to 32767).
+ *  @return The shaped axis value.
+ */
+static inline int16_t tiny_curve_apply(const int16_t *curve, int16_t value)
+{
+    if (!curve)
+        return value;
+
+    const uint16_t magnitude = (uint16_t)(value < 0 ? -value : value);
+    const uint8_t index = (uint8_t)(magnitude >> 11);
+    const int16_t low = (int16_t)tiny_input_read_word(&curve[index]);
+    const int16_t high = (int16_t)tiny_input_read_word(&curve[index + 1]);
+    const int16_t shaped = low + (int16_t)(((int32_t)(high - low) *
+            (magnitude & 0x07FF)) >> 11);
+
+    return value < 0 ? -shaped : shaped;
+}
+
+#endif